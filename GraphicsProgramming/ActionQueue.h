@@ -3,6 +3,8 @@
 #include <mutex>
 #include <queue>
 #include <functional>
+#include <coroutine>
+#include "CancellationToken.h"
 
 class ActionQueue
 {
@@ -10,9 +12,23 @@ public:
 	static ActionQueue& shared_instance() { static ActionQueue queue; return queue; }
 
 	void AddActionToQueue(std::function<void()> func);
-	void ClearFunctionQueue();
+	//Runs everything queued so far, returns how many actions that was.
+	size_t ClearFunctionQueue();
 	bool IsEmpty();
 
+	//co_await ActionQueue::shared_instance().schedule() continues the coroutine on the thread that clears the queue.
+	struct ScheduleAwaiter
+	{
+		ActionQueue& queue;
+		CancellationToken token;
+
+		bool await_ready() const noexcept { return token.is_cancelled(); }
+		void await_suspend(std::coroutine_handle<> handle) { queue.AddActionToQueue([handle] { handle.resume(); }); }
+		bool await_resume() const noexcept { return !token.is_cancelled(); }
+	};
+
+	ScheduleAwaiter schedule(CancellationToken token = {}) { return ScheduleAwaiter{ *this, std::move(token) }; }
+
 private:
 	std::mutex queueMutex;
 	std::queue<std::function<void()>> functionQueue;
@@ -21,21 +37,29 @@ private:
 inline void ActionQueue::AddActionToQueue(std::function<void()> func)
 {
 	std::unique_lock<std::mutex> lock(queueMutex);
-	functionQueue.emplace(func);
+	functionQueue.emplace(std::move(func));
 }
 
-inline void ActionQueue::ClearFunctionQueue()
+inline size_t ActionQueue::ClearFunctionQueue()
 {
-	std::unique_lock<std::mutex> lock(queueMutex);
-	for (int i = functionQueue.size() - 1; i >= 0; i--)
+	//Take the whole queue and run it unlocked, so actions can queue follow up work and workers aren't blocked meanwhile.
+	std::queue<std::function<void()>> pending;
 	{
-		auto& func = functionQueue.front();
-		func();
-		functionQueue.pop();
+		std::unique_lock<std::mutex> lock(queueMutex);
+		pending.swap(functionQueue);
 	}
+
+	size_t count = pending.size();
+	while (!pending.empty())
+	{
+		pending.front()();
+		pending.pop();
+	}
+	return count;
 }
 
 inline bool ActionQueue::IsEmpty()
 {
+	std::unique_lock<std::mutex> lock(queueMutex);
 	return functionQueue.empty();
 }
\ No newline at end of file
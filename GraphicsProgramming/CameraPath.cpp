@@ -0,0 +1,88 @@
+#include "CameraPath.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+bool CameraPath::save(const char* filePath) const
+{
+	std::ofstream file(filePath);
+
+	if (!file.is_open())
+	{
+		std::cout << "Failed to write camera path to " << filePath << std::endl;
+		return false;
+	}
+
+	file.precision(9);
+	for (auto& sample : samples)
+		file << sample.time << " " << sample.position.x << " " << sample.position.y << " " << sample.position.z << " " << sample.yaw << " " << sample.pitch << "\n";
+	return true;
+}
+
+bool CameraPath::load(const char* filePath)
+{
+	std::ifstream file(filePath);
+
+	if (!file.is_open())
+	{
+		std::cout << "Failed to read camera path " << filePath << std::endl;
+		return false;
+	}
+
+	samples.clear();
+	CameraSample sample;
+	while (file >> sample.time >> sample.position.x >> sample.position.y >> sample.position.z >> sample.yaw >> sample.pitch)
+		samples.push_back(sample);
+
+	if (samples.empty())
+	{
+		std::cout << "Camera path " << filePath << " has no samples" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+CameraPath CameraPath::flyover(const glm::vec3& from, const glm::vec3& to, double seconds, float pitch)
+{
+	glm::vec3 direction = to - from;
+	float yaw = glm::degrees(std::atan2(direction.x, direction.z));
+
+	CameraPath path;
+	path.record(CameraSample{ 0.0, from, yaw, pitch });
+	path.record(CameraSample{ seconds, to, yaw, pitch });
+	return path;
+}
+
+CameraSample CameraPath::sample(double time) const
+{
+	if (samples.empty())
+		return CameraSample();
+
+	time += samples.front().time;
+	auto next = std::upper_bound(samples.begin(), samples.end(), time, [](double t, const CameraSample& sample) { return t < sample.time; });
+
+	if (next == samples.begin())
+		return samples.front();
+	if (next == samples.end())
+		return samples.back();
+
+	auto& a = *(next - 1);
+	auto& b = *next;
+	float t = static_cast<float>((time - a.time) / (b.time - a.time));
+
+	//Yaw wraps at +-180, turn the short way round.
+	float yawDelta = b.yaw - a.yaw;
+	if (yawDelta > 180.0f)
+		yawDelta -= 360.0f;
+	if (yawDelta < -180.0f)
+		yawDelta += 360.0f;
+
+	CameraSample result;
+	result.time = time - samples.front().time;
+	result.position = glm::mix(a.position, b.position, t);
+	result.yaw = a.yaw + yawDelta * t;
+	result.pitch = a.pitch + (b.pitch - a.pitch) * t;
+	return result;
+}
\ No newline at end of file
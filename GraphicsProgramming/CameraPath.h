@@ -0,0 +1,38 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+//Camera state after input handling, yaw and pitch in degrees as main keeps them.
+struct CameraSample
+{
+	double time = 0.0;
+	glm::vec3 position = glm::vec3(0.0f);
+	float yaw = 0.0f;
+	float pitch = 0.0f;
+};
+
+//Timestamped camera samples. Recorded from free flight or scripted, then replayed at a fixed timestep so
+//every run of a benchmark sees the same views no matter how fast the frames come in.
+class CameraPath
+{
+public:
+	void record(const CameraSample& sample) { samples.push_back(sample); }
+	void clear() { samples.clear(); }
+
+	//Plain text, one "time x y z yaw pitch" line per sample.
+	bool save(const char* filePath) const;
+	bool load(const char* filePath);
+
+	//Straight line between two points at a constant speed, looking along the direction of travel.
+	static CameraPath flyover(const glm::vec3& from, const glm::vec3& to, double seconds, float pitch);
+
+	//Interpolated between the surrounding samples, clamped to the ends. Times are relative to the first sample.
+	CameraSample sample(double time) const;
+	double duration() const { return samples.size() < 2 ? 0.0 : samples.back().time - samples.front().time; }
+	bool empty() const { return samples.empty(); }
+	size_t size() const { return samples.size(); }
+
+private:
+	std::vector<CameraSample> samples;
+};
\ No newline at end of file
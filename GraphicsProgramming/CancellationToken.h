@@ -0,0 +1,31 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+//Shared cancellation flag. Copies observe the same state, so a token handed down a coroutine chain
+//can be cancelled from the owner at any point. A default constructed token can never be cancelled.
+class CancellationToken
+{
+public:
+	CancellationToken() = default;
+
+	static CancellationToken create() { CancellationToken token; token.state = std::make_shared<std::atomic_bool>(false); return token; }
+
+	void cancel() const;
+	bool is_cancelled() const;
+
+private:
+	std::shared_ptr<std::atomic_bool> state;
+};
+
+inline void CancellationToken::cancel() const
+{
+	if (state)
+		state->store(true, std::memory_order_relaxed);
+}
+
+inline bool CancellationToken::is_cancelled() const
+{
+	return state && state->load(std::memory_order_relaxed);
+}
\ No newline at end of file
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <glm/glm.hpp>
+
+//CPU side storage for one terrain chunk. The index list is shared by every chunk and lives in the TerrainArena.
+struct ChunkBuffers
+{
+	std::vector<float> vertices;
+};
+
+//Free list of chunk buffers. Generation draws from it on a worker and the upload returns to it on the upload thread,
+//so once streaming warms up no chunk allocates or frees its vertex storage.
+class ChunkBufferPool
+{
+public:
+	struct Recycler
+	{
+		void operator()(ChunkBuffers* buffers) const { ChunkBufferPool::shared_instance().release(buffers); }
+	};
+
+	using Handle = std::unique_ptr<ChunkBuffers, Recycler>;
+
+	static ChunkBufferPool& shared_instance() { static ChunkBufferPool pool; return pool; }
+
+	Handle acquire(size_t vertexFloats);
+
+	size_t allocated_count() const { return allocated.load(std::memory_order_relaxed); }
+	size_t free_count();
+
+	~ChunkBufferPool();
+
+private:
+	void release(ChunkBuffers* buffers);
+
+	std::mutex mutex;
+	std::vector<ChunkBuffers*> freeBuffers;
+	std::atomic<size_t> allocated = 0;
+};
+
+//Everything a generated chunk hands to the upload. Move only, the buffers travel from the worker to the upload
+//and, if kept, into the Plane without being copied.
+struct ChunkPayload
+{
+	glm::vec2 coordinate;
+	glm::vec3 position;
+	ChunkBufferPool::Handle buffers;
+	//World space box around the chunk, filled in once the heights are known.
+	glm::vec3 boundsMin = glm::vec3(0.0f);
+	glm::vec3 boundsMax = glm::vec3(0.0f);
+};
+
+inline ChunkBufferPool::Handle ChunkBufferPool::acquire(size_t vertexFloats)
+{
+	ChunkBuffers* buffers = nullptr;
+
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		if (!freeBuffers.empty())
+		{
+			buffers = freeBuffers.back();
+			freeBuffers.pop_back();
+		}
+	}
+
+	if (buffers == nullptr)
+	{
+		buffers = new ChunkBuffers();
+		allocated.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	//Same sized chunks keep their capacity, so these don't reallocate.
+	buffers->vertices.resize(vertexFloats);
+
+	return Handle(buffers);
+}
+
+inline void ChunkBufferPool::release(ChunkBuffers* buffers)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	freeBuffers.push_back(buffers);
+}
+
+inline size_t ChunkBufferPool::free_count()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	return freeBuffers.size();
+}
+
+inline ChunkBufferPool::~ChunkBufferPool()
+{
+	for (auto* buffers : freeBuffers)
+		delete buffers;
+}
\ No newline at end of file
@@ -0,0 +1,118 @@
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+bool DynamicResolution::initialize(int width, int height, ShaderProgram& upscaleProgram)
+{
+	outputWidth = width;
+	outputHeight = height;
+	currentScale = maxScale;
+
+	if (!target.create(static_cast<int>(std::ceil(width * maxScale)), static_cast<int>(std::ceil(height * maxScale))))
+		return false;
+
+	program = &upscaleProgram;
+	glUseProgram(upscaleProgram);
+	upscaleProgram.set_sampler("scene", 0);
+	uvScaleLocation = upscaleProgram.find_location("uvScale");
+	texelSizeLocation = upscaleProgram.find_location("texelSize");
+	sharpnessLocation = upscaleProgram.find_location("sharpness");
+
+	glGenQueries(static_cast<GLsizei>(queries.size()), queries.data());
+	glGenVertexArrays(1, &emptyVertexArray);
+	return true;
+}
+
+void DynamicResolution::begin_frame()
+{
+	renderWidth = std::clamp(static_cast<int>(std::lround(outputWidth * currentScale)), 1, target.width);
+	renderHeight = std::clamp(static_cast<int>(std::lround(outputHeight * currentScale)), 1, target.height);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+	glViewport(0, 0, renderWidth, renderHeight);
+
+	//A slot is only reused once its previous result has been read.
+	if (queriesInFlight < queryCount)
+		glBeginQuery(GL_TIME_ELAPSED, queries[nextQuery]);
+}
+
+void DynamicResolution::end_frame()
+{
+	if (queriesInFlight < queryCount)
+	{
+		glEndQuery(GL_TIME_ELAPSED);
+		nextQuery = (nextQuery + 1) % queryCount;
+		queriesInFlight++;
+	}
+
+	//Oldest first, stop at the first one the GPU hasn't finished.
+	while (queriesInFlight > 0)
+	{
+		GLuint oldest = queries[(nextQuery + queryCount - queriesInFlight) % queryCount];
+
+		GLint available = GL_FALSE;
+		glGetQueryObjectiv(oldest, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			break;
+
+		GLuint64 elapsedNs = 0;
+		glGetQueryObjectui64v(oldest, GL_QUERY_RESULT, &elapsedNs);
+		queriesInFlight--;
+
+		//Some drivers report garbage for the very first query of a context, nothing real takes a second.
+		if (elapsedNs < 1000000000ull)
+			update_scale(elapsedNs / 1e6);
+	}
+}
+
+void DynamicResolution::update_scale(double gpuMs)
+{
+	smoothedGpuMs = smoothedGpuMs == 0.0 ? gpuMs : smoothedGpuMs + (gpuMs - smoothedGpuMs) * 0.1;
+
+	if (!enabled)
+	{
+		currentScale = maxScale;
+		return;
+	}
+
+	if (++framesSinceChange < settleFrames || smoothedGpuMs <= 0.0)
+		return;
+
+	//Fragment cost follows the pixel count, which goes with the square of the scale. Drop quickly, recover slowly,
+	//so a heavy view is dealt with in a few frames and the scale doesn't oscillate on the way back up.
+	float wanted = currentScale * static_cast<float>(std::sqrt(targetGpuMs / smoothedGpuMs));
+	wanted = std::clamp(wanted, currentScale * 0.85f, currentScale * 1.05f);
+	wanted = std::clamp(wanted, minScale, maxScale);
+
+	if (std::abs(wanted - currentScale) < 0.01f)
+		return;
+
+	currentScale = wanted;
+	framesSinceChange = 0;
+}
+
+void DynamicResolution::present(RenderState& state, GLuint outputFramebuffer)
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer);
+	glViewport(0, 0, outputWidth, outputHeight);
+
+	state.set_enabled(Capability::DepthTest, false);
+	state.set_enabled(Capability::CullFace, false);
+	state.set_enabled(Capability::Blend, false);
+	state.set_enabled(Capability::StencilTest, false);
+	state.use_program(*program);
+	state.bind_vertex_array(emptyVertexArray);
+	state.bind_texture(0, GL_TEXTURE_2D, target.color);
+
+	//Sharpen in proportion to how far the image is stretched, at full size it is passed through untouched.
+	float upscale = maxScale > minScale ? (maxScale - currentScale) / (maxScale - minScale) : 0.0f;
+
+	glUniform2f(uvScaleLocation, renderWidth / static_cast<float>(target.width), renderHeight / static_cast<float>(target.height));
+	glUniform2f(texelSizeLocation, 1.0f / target.width, 1.0f / target.height);
+	glUniform1f(sharpnessLocation, sharpness * upscale);
+	RenderStats::shared_instance().uniformUploads += 3;
+
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	RenderStats::shared_instance().drawCalls++;
+}
\ No newline at end of file
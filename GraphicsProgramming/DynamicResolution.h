@@ -0,0 +1,67 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <array>
+
+#include "RenderTarget.h"
+#include "RenderState.h"
+#include "ShaderProgram.h"
+
+//Renders the scene offscreen at a fraction of the output size and scales it up to the window with a sharpening pass.
+//The fraction follows the GPU time of the scene, measured with GL_TIME_ELAPSED queries that are read a few frames
+//late so the CPU never waits on them. The target is allocated once at the largest size, smaller resolutions only
+//use the lower left part of it.
+class DynamicResolution
+{
+public:
+	//Scale bounds per axis relative to the output size, and the scene GPU time the scale is steered towards.
+	float minScale = 0.5f;
+	float maxScale = 1.0f;
+	double targetGpuMs = 12.0;
+	//Strength of the sharpening at the lowest scale, it fades out as the scale gets back to 1.
+	float sharpness = 0.5f;
+
+	//Off, the scene is drawn at maxScale every frame.
+	bool enabled = true;
+
+	bool initialize(int width, int height, ShaderProgram& upscaleProgram);
+
+	//Binds the offscreen target, sets the viewport to the current resolution and starts timing the scene.
+	void begin_frame();
+	//Stops timing, picks up finished timings and steers the scale.
+	void end_frame();
+	//Scales the scene into the output framebuffer, which has the size given to initialize.
+	void present(RenderState& state, GLuint outputFramebuffer);
+
+	float scale() const { return currentScale; }
+	double gpu_ms() const { return smoothedGpuMs; }
+	int render_width() const { return renderWidth; }
+	int render_height() const { return renderHeight; }
+
+private:
+	//Enough queries in flight that the oldest one has finished by the time it is read.
+	static constexpr size_t queryCount = 4;
+	//Frames to wait after a change before judging the new scale.
+	static constexpr int settleFrames = 8;
+
+	void update_scale(double gpuMs);
+
+	RenderTarget target;
+	ShaderProgram* program = nullptr;
+	GLint uvScaleLocation = -1;
+	GLint texelSizeLocation = -1;
+	GLint sharpnessLocation = -1;
+	GLuint emptyVertexArray = 0;
+
+	std::array<GLuint, queryCount> queries{};
+	size_t nextQuery = 0;
+	size_t queriesInFlight = 0;
+
+	int outputWidth = 0;
+	int outputHeight = 0;
+	int renderWidth = 0;
+	int renderHeight = 0;
+	float currentScale = 1.0f;
+	double smoothedGpuMs = 0.0;
+	int framesSinceChange = 0;
+};
\ No newline at end of file
@@ -41,6 +41,48 @@ unsigned int FileLoader::load_GL_texture(const char* filePath, int comp)
 	return textureId;
 }
 
+unsigned int FileLoader::load_GL_texture_array(const std::vector<const char*>& filePaths, int layerSize, int comp)
+{
+	unsigned int arrayId = 0;
+	glGenTextures(1, &arrayId);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, arrayId);
+
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, layerSize, layerSize, static_cast<GLsizei>(filePaths.size()), 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+	//The source images don't share a size, so each one is loaded as a regular texture and blitted into its layer.
+	GLuint framebuffers[2];
+	glGenFramebuffers(2, framebuffers);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffers[0]);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffers[1]);
+
+	for (size_t layer = 0; layer < filePaths.size(); ++layer)
+	{
+		unsigned int source = load_GL_texture(filePaths[layer], comp);
+
+		int width, height;
+		glBindTexture(GL_TEXTURE_2D, source);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, source, 0);
+		glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, arrayId, 0, static_cast<GLint>(layer));
+		glBlitFramebuffer(0, 0, width, height, 0, 0, layerSize, layerSize, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+
+		glDeleteTextures(1, &source);
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteFramebuffers(2, framebuffers);
+
+	glBindTexture(GL_TEXTURE_2D_ARRAY, arrayId);
+	glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	return arrayId;
+}
+
 void load_file(const char* filePath, std::promise<char*> promise)
 {
 	std::ifstream file(filePath, std::ios::binary);
@@ -72,8 +114,11 @@ std::future<char*> FileLoader::load_file_async(const char* filePath)
 	std::promise<char*> p;
 	auto future = p.get_future();
 
-	std::thread thread = std::thread(load_file, filePath, std::move(p));
-	thread.detach();
+	//Runs on the pool's I/O lane instead of a thread per file.
+	ThreadPool::shared_instance().enqueue_io([filePath, p = std::make_shared<std::promise<char*>>(std::move(p))]() mutable
+		{
+			load_file(filePath, std::move(*p));
+		});
 
 	return future;
 }
\ No newline at end of file
@@ -7,10 +7,14 @@
 #include <iostream>
 #include <future>
 #include <fstream>
+#include <vector>
+#include "ThreadPool.h"
 
 static class FileLoader
 {
 public:
 	static unsigned int load_GL_texture(const char* filePath, int comp = 0);
+	//Loads every file into one layer of a GL_TEXTURE_2D_ARRAY, each image is rescaled to layerSize on the GPU.
+	static unsigned int load_GL_texture_array(const std::vector<const char*>& filePaths, int layerSize, int comp = 0);
 	static std::future<char*> load_file_async(const char* filePath);
 };
\ No newline at end of file
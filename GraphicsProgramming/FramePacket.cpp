@@ -0,0 +1,66 @@
+#include "FramePacket.h"
+#include "Profiler.h"
+
+void FramePacket::reset()
+{
+	chunks.clear();
+	models.clear();
+	printRenderStats = false;
+	writeFrameReport = false;
+	toggleCapture = false;
+}
+
+FramePacket& FramePacketQueue::begin_write()
+{
+	PROFILE_SCOPE("Wait for free packet");
+
+	std::unique_lock<std::mutex> lock(mutex);
+	writable.wait(lock, [this] { return filled < packetCount; });
+
+	//Only this thread publishes, so the slot after the published ones stays ours until end_write.
+	auto& packet = packets[(head + filled) % packetCount];
+	lock.unlock();
+
+	packet.reset();
+	return packet;
+}
+
+void FramePacketQueue::end_write()
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		filled++;
+	}
+	readable.notify_one();
+}
+
+FramePacket* FramePacketQueue::begin_read()
+{
+	PROFILE_SCOPE("Wait for packet");
+
+	std::unique_lock<std::mutex> lock(mutex);
+	readable.wait(lock, [this] { return filled > 0 || closed; });
+
+	if (filled == 0)
+		return nullptr;
+	return &packets[head];
+}
+
+void FramePacketQueue::end_read()
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		head = (head + 1) % packetCount;
+		filled--;
+	}
+	writable.notify_one();
+}
+
+void FramePacketQueue::close()
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		closed = true;
+	}
+	readable.notify_all();
+}
\ No newline at end of file
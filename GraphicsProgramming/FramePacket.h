@@ -0,0 +1,75 @@
+#pragma once
+
+#include <array>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include "Renderer.h"
+
+//Toggled from the keyboard on the main thread, applied by the render thread when it draws the packet.
+struct RenderSettings
+{
+	bool depthPrepass = false;
+	bool showOverdraw = false;
+	bool dynamicResolution = true;
+};
+
+struct ModelDraw
+{
+	Model* model;
+	glm::vec3 position;
+	glm::vec3 rotation;
+	glm::vec3 scale;
+};
+
+//Everything the render thread needs for one frame, filled by the main thread and not touched by it again until the
+//render thread hands the packet back. Nothing in it points at main thread state that can change in the meantime.
+struct FramePacket
+{
+	uint64_t frameIndex = 0;
+	WorldInformation worldInformation;
+	RenderSettings settings;
+
+	//Resident chunks only, placeholders still being generated are left out.
+	std::vector<ChunkDraw> chunks;
+	std::vector<ModelDraw> models;
+
+	//One shot requests from the keyboard.
+	bool printRenderStats = false;
+	bool writeFrameReport = false;
+	bool toggleCapture = false;
+
+	//Clears the lists without giving up their capacity.
+	void reset();
+};
+
+//Ring of frame packets between the main thread and the render thread. The main thread fills the next free packet
+//while the render thread draws an older one, so it can run up to packetCount - 1 frames ahead before it waits.
+class FramePacketQueue
+{
+public:
+	static constexpr size_t packetCount = 3;
+
+	//Main thread. Waits for a free packet and returns it reset, publish it with end_write.
+	FramePacket& begin_write();
+	void end_write();
+
+	//Render thread. Waits for the oldest published packet, nullptr once closed and drained. Return it with end_read.
+	FramePacket* begin_read();
+	void end_read();
+
+	//No more packets, the render thread finishes the ones already published.
+	void close();
+
+private:
+	std::array<FramePacket, packetCount> packets;
+	//Oldest published packet and how many are published or being drawn.
+	size_t head = 0;
+	size_t filled = 0;
+	bool closed = false;
+
+	std::mutex mutex;
+	std::condition_variable writable;
+	std::condition_variable readable;
+};
\ No newline at end of file
@@ -0,0 +1,127 @@
+#include "FrameStats.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+size_t FrameStats::bucket(double frameMs)
+{
+	return std::min(static_cast<size_t>(std::max(frameMs, 0.0) / bucketMs), bucketCount - 1);
+}
+
+void FrameStats::end_frame(FrameRecord record)
+{
+	auto now = Clock::now();
+	if (lastFrame == Clock::time_point())
+	{
+		lastFrame = now;
+		return;
+	}
+
+	record.frameMs = std::chrono::duration<double, std::milli>(now - lastFrame).count();
+	lastFrame = now;
+
+	//The oldest frame drops out of the window once it is full.
+	auto& slot = frames[nextFrame];
+	if (windowCount == windowFrames)
+	{
+		histogram[bucket(slot.frameMs)]--;
+		if (slot.frameMs > hitchThresholdMs)
+			windowHitches--;
+	}
+	else
+	{
+		windowCount++;
+	}
+
+	slot = record;
+	nextFrame = (nextFrame + 1) % windowFrames;
+
+	histogram[bucket(record.frameMs)]++;
+	bool hitch = record.frameMs > hitchThresholdMs;
+	windowHitches += hitch;
+
+	sessionFrames++;
+	sessionHitches += hitch;
+	sessionChunksUploaded += record.chunksUploaded;
+	sessionBytesUploaded += record.bytesUploaded;
+	sessionFrameDataBytes += record.frameDataBytes;
+	sessionMs += record.frameMs;
+}
+
+double FrameStats::percentile_ms(double percentile) const
+{
+	if (windowCount == 0)
+		return 0.0;
+
+	size_t target = static_cast<size_t>(percentile * (windowCount - 1)) + 1;
+	size_t seen = 0;
+
+	for (size_t i = 0; i < bucketCount; ++i)
+	{
+		seen += histogram[i];
+		if (seen >= target)
+			return (i + 1) * bucketMs;
+	}
+	return bucketCount * bucketMs;
+}
+
+double FrameStats::max_ms() const
+{
+	double slowest = 0.0;
+	for (size_t i = 0; i < windowCount; ++i)
+		slowest = std::max(slowest, frames[i].frameMs);
+	return slowest;
+}
+
+void FrameStats::print(std::ostream& stream) const
+{
+	stream << "Frames: " << windowCount << ", p50: " << percentile_ms(0.5) << " ms, p95: " << percentile_ms(0.95) << " ms, p99: " << percentile_ms(0.99)
+		<< " ms, max: " << max_ms() << " ms, hitches over " << hitchThresholdMs << " ms: " << windowHitches << std::endl;
+}
+
+bool FrameStats::write_csv(const char* filePath) const
+{
+	std::ofstream file(filePath);
+
+	if (!file.is_open())
+	{
+		std::cout << "Failed to write frame stats to " << filePath << std::endl;
+		return false;
+	}
+
+	file << "frame,frameMs,drawCalls,chunksUploaded,bytesUploaded,frameDataBytes,queuedActions,finishedUploads,sceneGpuMs,resolutionScale\n";
+
+	//Oldest first, the ring starts at nextFrame once it has wrapped.
+	size_t first = windowCount == windowFrames ? nextFrame : 0;
+	for (size_t i = 0; i < windowCount; ++i)
+	{
+		auto& frame = frames[(first + i) % windowFrames];
+		file << sessionFrames - windowCount + i << "," << frame.frameMs << "," << frame.drawCalls << "," << frame.chunksUploaded << ","
+			<< frame.bytesUploaded << "," << frame.frameDataBytes << "," << frame.queuedActions << "," << frame.finishedUploads << "," << frame.sceneGpuMs << "," << frame.resolutionScale << "\n";
+	}
+	return true;
+}
+
+bool FrameStats::write_json(const char* filePath) const
+{
+	std::ofstream file(filePath);
+
+	if (!file.is_open())
+	{
+		std::cout << "Failed to write frame stats to " << filePath << std::endl;
+		return false;
+	}
+
+	double drawCalls = 0.0;
+	for (size_t i = 0; i < windowCount; ++i)
+		drawCalls += frames[i].drawCalls;
+
+	file << "{\n  \"window\": { \"frames\": " << windowCount << ", \"p50Ms\": " << percentile_ms(0.5) << ", \"p95Ms\": " << percentile_ms(0.95)
+		<< ", \"p99Ms\": " << percentile_ms(0.99) << ", \"maxMs\": " << max_ms() << ", \"hitchThresholdMs\": " << hitchThresholdMs
+		<< ", \"hitches\": " << windowHitches << ", \"averageDrawCalls\": " << (windowCount > 0 ? drawCalls / windowCount : 0.0) << " },\n";
+	file << "  \"session\": { \"frames\": " << sessionFrames << ", \"averageMs\": " << (sessionFrames > 0 ? sessionMs / sessionFrames : 0.0)
+		<< ", \"hitches\": " << sessionHitches << ", \"chunksUploaded\": " << sessionChunksUploaded << ", \"bytesUploaded\": " << sessionBytesUploaded
+		<< ", \"frameDataBytes\": " << sessionFrameDataBytes << " }\n}\n";
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+//Counters gathered once per frame, the frame time is filled in by FrameStats::end_frame.
+struct FrameRecord
+{
+	double frameMs = 0.0;
+	unsigned int drawCalls = 0;
+	unsigned int chunksUploaded = 0;
+	unsigned int bytesUploaded = 0;
+	//Uniform blocks and instance matrices, refilled every frame whether anything streams or not.
+	unsigned int frameDataBytes = 0;
+	size_t queuedActions = 0;
+	//Uploads from the UploadQueue finished on the render thread, see UploadQueue::collect.
+	size_t finishedUploads = 0;
+	//Smoothed GPU time of the scene and the resolution scale it was drawn at, see DynamicResolution.
+	double sceneGpuMs = 0.0;
+	float resolutionScale = 1.0f;
+};
+
+//Frame times over the last windowFrames frames, kept as a histogram that frames enter and leave as the window rolls,
+//so percentiles cost the same however long the session runs. Render thread only, read on the main thread after it joined.
+class FrameStats
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	static constexpr size_t windowFrames = 3600;
+	//0.1 ms buckets up to 100 ms, the last one takes everything slower.
+	static constexpr double bucketMs = 0.1;
+	static constexpr size_t bucketCount = 1000;
+
+	static FrameStats& shared_instance() { static FrameStats stats; return stats; }
+
+	//Frames slower than this count as hitches, two frames at 60 Hz.
+	static constexpr double hitchThresholdMs = 1000.0 / 30.0;
+
+	//Call at the end of every frame, the time since the previous call becomes the frame time. The first call only starts the clock.
+	void end_frame(FrameRecord record);
+
+	//Upper bound of the bucket holding the percentile, over the window.
+	double percentile_ms(double percentile) const;
+	double max_ms() const;
+	size_t window_size() const { return windowCount; }
+	size_t window_hitches() const { return windowHitches; }
+
+	void print(std::ostream& stream) const;
+	//One row per frame in the window.
+	bool write_csv(const char* filePath) const;
+	//Summary of the window plus session totals.
+	bool write_json(const char* filePath) const;
+
+private:
+	static size_t bucket(double frameMs);
+
+	Clock::time_point lastFrame;
+
+	std::vector<FrameRecord> frames = std::vector<FrameRecord>(windowFrames);
+	size_t nextFrame = 0;
+	size_t windowCount = 0;
+
+	std::array<uint32_t, bucketCount> histogram{};
+	size_t windowHitches = 0;
+
+	uint64_t sessionFrames = 0;
+	uint64_t sessionHitches = 0;
+	uint64_t sessionChunksUploaded = 0;
+	uint64_t sessionBytesUploaded = 0;
+	uint64_t sessionFrameDataBytes = 0;
+	double sessionMs = 0.0;
+};
\ No newline at end of file
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include "Model.h"
+#include "Task.h"
+#include "UploadQueue.h"
+
+//Owns every loaded Model, keyed by path, so entities sharing an asset share its meshes, textures and instance buffer.
+//Only touched from the main thread, load_async fills its models in on the upload and render threads.
+class ModelRegistry
+{
+public:
+	static ModelRegistry& shared_instance() { static ModelRegistry registry; return registry; }
+
+	//Loads the model the first time a path is asked for, afterwards returns the same instance.
+	//A format only applies to that first load, VertexFormat::Packed is a quarter of the vertex memory for static meshes.
+	Model* load(const std::string& path, VertexFormat format = VertexFormat::Full);
+	//Returns an empty model right away and loads it on the UploadQueue, it's ready to draw a few frames later.
+	//flipTextures is the stb_image flip flag for the model's textures, the uploads run one at a time so it can't leak
+	//into another load.
+	Model* load_async(const std::string& path, bool flipTextures = false, VertexFormat format = VertexFormat::Full);
+
+	size_t size() const { return models.size(); }
+
+	//Frees all models, call before the GL context goes away.
+	void clear() { models.clear(); }
+
+private:
+	static Task upload_model(Model* model, std::string path, bool flipTextures, VertexFormat format);
+
+	std::unordered_map<std::string, std::unique_ptr<Model>> models;
+};
+
+inline Model* ModelRegistry::load(const std::string& path, VertexFormat format)
+{
+	auto& model = models[path];
+	if (!model)
+		model = std::make_unique<Model>(path, false, format);
+
+	return model.get();
+}
+
+
+inline Model* ModelRegistry::load_async(const std::string& path, bool flipTextures, VertexFormat format)
+{
+	auto& model = models[path];
+	if (!model)
+	{
+		model = std::make_unique<Model>();
+		upload_model(model.get(), path, flipTextures, format).detach();
+	}
+
+	return model.get();
+}
+
+inline Task ModelRegistry::upload_model(Model* model, std::string path, bool flipTextures, VertexFormat format)
+{
+	auto& uploads = UploadQueue::shared_instance();
+	co_await uploads.schedule();
+
+	stbi_set_flip_vertically_on_load(flipTextures);
+	model->loadModel(path, format);
+
+	//Render thread from here, vertex arrays belong to the context that draws them.
+	co_await uploads.completion();
+	model->setupVertexArrays();
+}
\ No newline at end of file
@@ -7,4 +7,75 @@ void Parallel::parallelFor(const int start, const int end, const std::function<v
 		threadPool.enqueue([=]() {body(i); });
 	}
 	return;
+}
+
+namespace
+{
+	//Shared with the queued helpers, one that only starts after the caller returned finds no indices left and never
+	//touches the body.
+	struct JoinState
+	{
+		std::atomic_int next;
+		std::atomic_int remaining;
+		int end;
+		const std::function<void(int)>* body;
+	};
+
+	void run_join_indices(JoinState& state)
+	{
+		for (int i = state.next.fetch_add(1, std::memory_order_relaxed); i < state.end; i = state.next.fetch_add(1, std::memory_order_relaxed))
+		{
+			(*state.body)(i);
+			if (state.remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				state.remaining.notify_all();
+		}
+	}
+}
+
+void Parallel::parallelForJoin(const int start, const int end, const std::function<void(int)>& body, ThreadPool& threadPool, TaskPriority priority)
+{
+	if (start >= end)
+		return;
+
+	auto state = std::make_shared<JoinState>();
+	state->next = start;
+	state->remaining = end - start;
+	state->end = end;
+	state->body = &body;
+
+	//The caller takes one share itself.
+	for (int i = start + 1; i < end; ++i)
+		threadPool.enqueue([state] { run_join_indices(*state); }, priority);
+
+	run_join_indices(*state);
+
+	//Only indices a worker is still running are left.
+	for (int left = state->remaining.load(std::memory_order_acquire); left != 0; left = state->remaining.load(std::memory_order_acquire))
+		state->remaining.wait(left, std::memory_order_acquire);
+}
+
+ParallelForAwaiter Parallel::parallelForAsync(const int start, const int end, std::function<void(int)> body, ThreadPool& threadPool, TaskPriority priority)
+{
+	return ParallelForAwaiter(start, end, std::move(body), threadPool, priority);
+}
+
+void ParallelForAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+	continuation = handle;
+
+	//The awaiter lives in the coroutine frame, which may be resumed and destroyed before this loop returns.
+	//So only locals are touched after the first task has been queued.
+	const int first = start, last = end;
+	const TaskPriority lanePriority = priority;
+	ThreadPool& pool = threadPool;
+
+	for (int i = first; i < last; ++i)
+	{
+		pool.enqueue([this, i]()
+			{
+				body(i);
+				if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+					continuation.resume();
+			}, lanePriority);
+	}
 }
\ No newline at end of file
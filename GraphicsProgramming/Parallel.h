@@ -2,11 +2,36 @@
 
 #include <functional>
 #include <thread>
+#include <atomic>
+#include <coroutine>
 #include "ThreadPool.h"
 
+//Awaitable form of Parallel::parallelFor, the awaiting coroutine is resumed by whichever worker finishes the last index.
+class ParallelForAwaiter
+{
+public:
+	ParallelForAwaiter(const int start, const int end, std::function<void(int)> body, ThreadPool& threadPool, TaskPriority priority)
+		: start(start), end(end), body(std::move(body)), threadPool(threadPool), priority(priority), remaining(end - start) {}
+
+	bool await_ready() const noexcept { return start >= end; }
+	void await_suspend(std::coroutine_handle<> handle);
+	void await_resume() const noexcept {}
+
+private:
+	const int start, end;
+	std::function<void(int)> body;
+	ThreadPool& threadPool;
+	TaskPriority priority;
+	std::coroutine_handle<> continuation;
+	std::atomic_int remaining;
+};
+
 class Parallel
 {
 public:
 	static void parallelFor(const int start, const int end, const std::function<void(int)> body, ThreadPool& threadPool);
-
+	//Blocking, the calling thread works through the indices as well. Returns once every index has run, without waiting for
+	//busy workers to get to the ones nobody has picked up yet. For short per-frame jobs.
+	static void parallelForJoin(const int start, const int end, const std::function<void(int)>& body, ThreadPool& threadPool, TaskPriority priority = TaskPriority::FrameCritical);
+	static ParallelForAwaiter parallelForAsync(const int start, const int end, std::function<void(int)> body, ThreadPool& threadPool, TaskPriority priority = TaskPriority::Background);
 };
\ No newline at end of file
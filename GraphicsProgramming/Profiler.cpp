@@ -0,0 +1,184 @@
+#include "Profiler.h"
+
+#if ENABLE_PROFILER
+
+#include <fstream>
+#include <iostream>
+
+uint32_t Profiler::thread_index()
+{
+	static std::atomic<uint32_t> nextThread = 1;
+	thread_local uint32_t index = nextThread.fetch_add(1, std::memory_order_relaxed);
+	return index;
+}
+
+void Profiler::set_thread_name(const char* name)
+{
+	auto thread = thread_index();
+
+	std::unique_lock<std::mutex> lock(mutex);
+	for (auto& threadName : threadNames)
+	{
+		if (threadName.first == thread)
+		{
+			threadName.second = name;
+			return;
+		}
+	}
+	threadNames.emplace_back(thread, name);
+}
+
+void Profiler::start_capture()
+{
+	//GL_TIMESTAMP counts in its own epoch, read both clocks back to back to map one onto the other.
+	GLint64 gpuNow = 0;
+	glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+	auto cpuNow = Clock::now();
+	gpuToCpuNs = std::chrono::duration_cast<std::chrono::nanoseconds>(cpuNow.time_since_epoch()).count() - gpuNow;
+
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		events.clear();
+		captureStart = cpuNow;
+	}
+	active.store(true, std::memory_order_relaxed);
+}
+
+void Profiler::stop_capture(const char* filePath)
+{
+	resolve_gpu(true);
+	active.store(false, std::memory_order_relaxed);
+	write_chrome_trace(filePath);
+}
+
+void Profiler::record_cpu(const char* name, Clock::time_point start, Clock::time_point end)
+{
+	if (!capturing())
+		return;
+
+	auto thread = thread_index();
+	auto startNs = std::chrono::duration_cast<std::chrono::nanoseconds>(start.time_since_epoch()).count();
+	auto durationNs = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+
+	std::unique_lock<std::mutex> lock(mutex);
+	if (events.size() < maxEvents)
+		events.push_back(ProfileEvent{ name, startNs, durationNs, thread });
+}
+
+void Profiler::record_counter(const char* name, int64_t value)
+{
+	if (!capturing())
+		return;
+
+	auto nowNs = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+
+	std::unique_lock<std::mutex> lock(mutex);
+	if (events.size() < maxEvents)
+		events.push_back(ProfileEvent{ name, nowNs, 0, thread_index(), true, value });
+}
+
+int Profiler::begin_gpu(const char* name)
+{
+	GpuZone zone{ name, {}, false };
+	for (auto& query : zone.queries)
+	{
+		if (freeQueries.empty())
+		{
+			glGenQueries(1, &query);
+			continue;
+		}
+
+		query = freeQueries.back();
+		freeQueries.pop_back();
+	}
+
+	glQueryCounter(zone.queries[0], GL_TIMESTAMP);
+	pendingGpu.push_back(zone);
+	return static_cast<int>(pendingGpu.size() - 1);
+}
+
+void Profiler::end_gpu(int zone)
+{
+	glQueryCounter(pendingGpu[zone].queries[1], GL_TIMESTAMP);
+	pendingGpu[zone].ended = true;
+}
+
+void Profiler::collect_gpu()
+{
+	resolve_gpu(false);
+}
+
+void Profiler::resolve_gpu(bool wait)
+{
+	//Zones finish in submission order, stop at the first one the GPU hasn't reached yet.
+	size_t resolved = 0;
+	for (; resolved < pendingGpu.size(); ++resolved)
+	{
+		auto& zone = pendingGpu[resolved];
+		if (!zone.ended)
+			break;
+
+		if (!wait)
+		{
+			GLint available = GL_FALSE;
+			glGetQueryObjectiv(zone.queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available)
+				break;
+		}
+
+		GLuint64 start = 0, end = 0;
+		glGetQueryObjectui64v(zone.queries[0], GL_QUERY_RESULT, &start);
+		glGetQueryObjectui64v(zone.queries[1], GL_QUERY_RESULT, &end);
+		freeQueries.push_back(zone.queries[0]);
+		freeQueries.push_back(zone.queries[1]);
+
+		if (!capturing())
+			continue;
+
+		std::unique_lock<std::mutex> lock(mutex);
+		if (events.size() < maxEvents)
+			events.push_back(ProfileEvent{ zone.name, static_cast<int64_t>(start) + gpuToCpuNs, static_cast<int64_t>(end - start), 0 });
+	}
+
+	pendingGpu.erase(pendingGpu.begin(), pendingGpu.begin() + resolved);
+}
+
+void Profiler::write_chrome_trace(const char* filePath)
+{
+	std::ofstream file(filePath);
+
+	if (!file.is_open())
+	{
+		std::cout << "Failed to write profile to " << filePath << std::endl;
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(mutex);
+	auto originNs = std::chrono::duration_cast<std::chrono::nanoseconds>(captureStart.time_since_epoch()).count();
+
+	//Complete events, timestamps and durations in microseconds.
+	file << "{ \"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+	file << "  { \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 0, \"args\": { \"name\": \"GPU\" } }";
+	for (auto& [thread, name] : threadNames)
+		file << ",\n  { \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << thread << ", \"args\": { \"name\": \"" << name << "\" } }";
+
+	file.setf(std::ios::fixed);
+	file.precision(3);
+	for (auto& event : events)
+	{
+		if (event.counter)
+		{
+			file << ",\n  { \"name\": \"" << event.name << "\", \"ph\": \"C\", \"pid\": 1, \"ts\": " << (event.startNs - originNs) / 1000.0
+				<< ", \"args\": { \"value\": " << event.value << " } }";
+			continue;
+		}
+
+		file << ",\n  { \"name\": \"" << event.name << "\", \"cat\": \"" << (event.thread == 0 ? "gpu" : "cpu") << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << event.thread
+			<< ", \"ts\": " << (event.startNs - originNs) / 1000.0 << ", \"dur\": " << event.durationNs / 1000.0 << " }";
+	}
+	file << "\n] }\n";
+
+	std::cout << "Wrote " << events.size() << " profile zones to " << filePath << std::endl;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+//On in debug builds, define ENABLE_PROFILER=1 to keep it in a release build. Off, every macro below expands to nothing.
+#ifndef ENABLE_PROFILER
+#ifdef _DEBUG
+#define ENABLE_PROFILER 1
+#else
+#define ENABLE_PROFILER 0
+#endif
+#endif
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#if ENABLE_PROFILER
+//CPU zone from here to the end of the scope, usable on any thread.
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+//GPU zone timed with GL_TIMESTAMP queries, only on the thread that owns the GL context.
+#define PROFILE_GPU_SCOPE(name) GpuProfileScope PROFILE_CONCAT(gpuProfileScope, __LINE__)(name)
+#define PROFILE_THREAD_NAME(name) Profiler::shared_instance().set_thread_name(name)
+//Value plotted as its own track, e.g. a per frame count.
+#define PROFILE_COUNTER(name, value) Profiler::shared_instance().record_counter(name, value)
+#else
+#define PROFILE_SCOPE(name)
+#define PROFILE_GPU_SCOPE(name)
+#define PROFILE_THREAD_NAME(name)
+#define PROFILE_COUNTER(name, value)
+#endif
+
+#if ENABLE_PROFILER
+
+struct ProfileEvent
+{
+	const char* name;
+	int64_t startNs;
+	int64_t durationNs;
+	//0 is the GPU track, threads count up from 1.
+	uint32_t thread;
+	//Counters only have a time and this value.
+	bool counter = false;
+	int64_t value = 0;
+};
+
+//Zones are only kept between start_capture and stop_capture, stop writes them out as Chrome trace JSON
+//that chrome://tracing and ui.perfetto.dev open. Names must outlive the capture, string literals in practice.
+class Profiler
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	//Caps the memory a forgotten capture can take.
+	static constexpr size_t maxEvents = 1 << 20;
+
+	static Profiler& shared_instance() { static Profiler profiler; return profiler; }
+
+	//Both on the GL thread, start lines the GPU clock up with the CPU one, stop waits for outstanding GPU zones.
+	void start_capture();
+	void stop_capture(const char* filePath);
+	bool capturing() const { return active.load(std::memory_order_relaxed); }
+
+	//Label for the calling thread in the trace.
+	void set_thread_name(const char* name);
+
+	void record_cpu(const char* name, Clock::time_point start, Clock::time_point end);
+	void record_counter(const char* name, int64_t value);
+
+	//GL thread only. The timestamps are written into the command stream, begin returns the zone to end.
+	int begin_gpu(const char* name);
+	void end_gpu(int zone);
+	//Once per frame while no GPU zone is open, picks up finished zones without waiting on them.
+	void collect_gpu();
+
+private:
+	struct GpuZone
+	{
+		const char* name;
+		GLuint queries[2];
+		bool ended = false;
+	};
+
+	static uint32_t thread_index();
+
+	void resolve_gpu(bool wait);
+	void write_chrome_trace(const char* filePath);
+
+	std::atomic_bool active = false;
+	std::mutex mutex;
+	std::vector<ProfileEvent> events;
+	std::vector<std::pair<uint32_t, const char*>> threadNames;
+	Clock::time_point captureStart;
+
+	//GL thread only.
+	std::vector<GLuint> freeQueries;
+	std::vector<GpuZone> pendingGpu;
+	int64_t gpuToCpuNs = 0;
+};
+
+class ProfileScope
+{
+public:
+	explicit ProfileScope(const char* name) : name(name)
+	{
+		if (Profiler::shared_instance().capturing())
+			start = Profiler::Clock::now();
+	}
+
+	~ProfileScope()
+	{
+		//A capture that started halfway through the scope has no start to go on.
+		if (start != Profiler::Clock::time_point())
+			Profiler::shared_instance().record_cpu(name, start, Profiler::Clock::now());
+	}
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+	const char* name;
+	Profiler::Clock::time_point start;
+};
+
+class GpuProfileScope
+{
+public:
+	explicit GpuProfileScope(const char* name)
+	{
+		auto& profiler = Profiler::shared_instance();
+		if (profiler.capturing())
+			zone = profiler.begin_gpu(name);
+	}
+
+	~GpuProfileScope()
+	{
+		if (zone >= 0)
+			Profiler::shared_instance().end_gpu(zone);
+	}
+
+	GpuProfileScope(const GpuProfileScope&) = delete;
+	GpuProfileScope& operator=(const GpuProfileScope&) = delete;
+
+private:
+	int zone = -1;
+};
+
+#endif
\ No newline at end of file
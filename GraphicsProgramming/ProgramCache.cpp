@@ -0,0 +1,148 @@
+#include "ProgramCache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+static std::uint64_t fnv1a(std::uint64_t hash, const char* data)
+{
+	for (; *data != '\0'; ++data)
+	{
+		hash ^= static_cast<unsigned char>(*data);
+		hash *= 1099511628211ull;
+	}
+
+	//Separator, so moving text from one input to the next changes the hash.
+	hash ^= 0xFF;
+	hash *= 1099511628211ull;
+	return hash;
+}
+
+void ProgramCache::initialize(GLADloadproc loader, const char* directory)
+{
+	cacheDirectory = directory;
+	driver = std::string(reinterpret_cast<const char*>(glGetString(GL_VENDOR))) + "|"
+		+ reinterpret_cast<const char*>(glGetString(GL_RENDERER)) + "|"
+		+ reinterpret_cast<const char*>(glGetString(GL_VERSION));
+
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	//Older contexts don't know the enum at all.
+	glGetError();
+
+	if (formats <= 0)
+	{
+		std::cout << "Program binaries not supported, shaders are compiled on every launch." << std::endl;
+		return;
+	}
+
+	binaryFormats.resize(formats);
+	glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, binaryFormats.data());
+
+	getProgramBinary = reinterpret_cast<GetProgramBinaryProc>(loader("glGetProgramBinary"));
+	programBinary = reinterpret_cast<ProgramBinaryProc>(loader("glProgramBinary"));
+	programParameteri = reinterpret_cast<ProgramParameteriProc>(loader("glProgramParameteri"));
+
+	std::error_code error;
+	std::filesystem::create_directories(cacheDirectory, error);
+}
+
+std::uint64_t ProgramCache::key(const char* vertexSrc, const char* fragmentSrc, const char* defines) const
+{
+	std::uint64_t hash = 14695981039346656037ull;
+	hash = fnv1a(hash, vertexSrc);
+	hash = fnv1a(hash, fragmentSrc);
+	hash = fnv1a(hash, defines);
+	hash = fnv1a(hash, driver.c_str());
+	return hash;
+}
+
+std::string ProgramCache::path(std::uint64_t key) const
+{
+	char name[32];
+	std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+	return cacheDirectory + "/" + name;
+}
+
+GLuint ProgramCache::load(std::uint64_t key)
+{
+	if (!enabled())
+	{
+		cacheStats.misses++;
+		return 0;
+	}
+
+	std::ifstream file(path(key), std::ios::binary | std::ios::ate);
+	if (!file.is_open())
+	{
+		cacheStats.misses++;
+		return 0;
+	}
+
+	auto size = static_cast<std::streamoff>(file.tellg());
+	if (size <= static_cast<std::streamoff>(sizeof(GLenum)))
+	{
+		cacheStats.misses++;
+		return 0;
+	}
+
+	GLenum format = 0;
+	std::vector<char> binary(static_cast<size_t>(size) - sizeof(GLenum));
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(&format), sizeof(format));
+	file.read(binary.data(), binary.size());
+
+	if (std::find(binaryFormats.begin(), binaryFormats.end(), static_cast<GLint>(format)) == binaryFormats.end())
+	{
+		cacheStats.rejected++;
+		return 0;
+	}
+
+	GLuint program = glCreateProgram();
+	programBinary(program, format, binary.data(), static_cast<GLsizei>(binary.size()));
+
+	GLint linked = 0;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (!linked)
+	{
+		//Usually a driver update that kept the version string, the caller recompiles and overwrites the entry.
+		glDeleteProgram(program);
+		cacheStats.rejected++;
+		return 0;
+	}
+
+	cacheStats.hits++;
+	return program;
+}
+
+void ProgramCache::prepare(GLuint program) const
+{
+	if (enabled() && programParameteri != nullptr)
+		programParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+void ProgramCache::store(std::uint64_t key, GLuint program)
+{
+	if (!enabled())
+		return;
+
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+
+	GLenum format = 0;
+	std::vector<char> binary(length);
+	getProgramBinary(program, length, nullptr, &format, binary.data());
+
+	std::ofstream file(path(key), std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		return;
+
+	file.write(reinterpret_cast<const char*>(&format), sizeof(format));
+	file.write(binary.data(), binary.size());
+	cacheStats.stored++;
+}
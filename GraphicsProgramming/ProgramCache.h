@@ -0,0 +1,64 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//GL 4.1 / ARB_get_program_binary, the loader only knows 3.3 so these are fetched by hand.
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#define GL_PROGRAM_BINARY_FORMATS 0x87FF
+#endif
+
+struct ProgramCacheStats
+{
+	unsigned int hits = 0;
+	unsigned int misses = 0;
+	unsigned int rejected = 0;
+	unsigned int stored = 0;
+};
+
+//Keeps linked programs on disk so later launches skip compiling. A binary is only valid for the exact sources and
+//driver it came from, both are part of the key. A driver may still refuse an old binary, the caller then recompiles
+//and the fresh binary replaces it.
+class ProgramCache
+{
+public:
+	//Does nothing, and every load misses, when the driver can't hand out program binaries.
+	void initialize(GLADloadproc loader, const char* directory = "ShaderCache");
+
+	bool enabled() const { return getProgramBinary != nullptr && programBinary != nullptr; }
+
+	std::uint64_t key(const char* vertexSrc, const char* fragmentSrc, const char* defines = "") const;
+
+	//Returns a linked program, or 0 when there is no usable binary for the key.
+	GLuint load(std::uint64_t key);
+
+	//Call before linking a program that is going to be stored.
+	void prepare(GLuint program) const;
+	void store(std::uint64_t key, GLuint program);
+
+	const ProgramCacheStats& stats() const { return cacheStats; }
+
+private:
+	using GetProgramBinaryProc = void (APIENTRYP)(GLuint, GLsizei, GLsizei*, GLenum*, void*);
+	using ProgramBinaryProc = void (APIENTRYP)(GLuint, GLenum, const void*, GLsizei);
+	using ProgramParameteriProc = void (APIENTRYP)(GLuint, GLenum, GLint);
+
+	std::string path(std::uint64_t key) const;
+
+	GetProgramBinaryProc getProgramBinary = nullptr;
+	ProgramBinaryProc programBinary = nullptr;
+	ProgramParameteriProc programParameteri = nullptr;
+
+	//Anything else in a cache file is corrupt, glProgramBinary would raise an error instead of failing the link.
+	std::vector<GLint> binaryFormats;
+
+	std::string cacheDirectory;
+	//Vendor, renderer and version, a driver update invalidates everything.
+	std::string driver;
+	ProgramCacheStats cacheStats;
+};
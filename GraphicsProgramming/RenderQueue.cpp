@@ -0,0 +1,62 @@
+#include "RenderQueue.h"
+
+#include <algorithm>
+
+uint64_t RenderQueue::make_key(RenderPass pass, GLuint program, uint16_t material, float viewDepth, GLuint vao)
+{
+	constexpr uint64_t depthMax = (1ull << 24) - 1;
+
+	auto normalized = std::clamp(viewDepth / maxSortDepth, 0.0f, 1.0f);
+	auto depth = static_cast<uint64_t>(normalized * depthMax);
+
+	//Transparent geometry blends over what's behind it, so it has to go far to near.
+	if (pass == RenderPass::Transparent)
+		depth = depthMax - depth;
+
+	return (static_cast<uint64_t>(pass) & 0xF) << 60
+		| (static_cast<uint64_t>(program) & 0xFF) << 52
+		| (static_cast<uint64_t>(material) & 0xFFF) << 40
+		| depth << 16
+		| (static_cast<uint64_t>(vao) & 0xFFFF);
+}
+
+const std::vector<const DrawItem*>& RenderQueue::sort()
+{
+	const auto count = items.size();
+
+	keys.resize(count);
+	swapKeys.resize(count);
+	for (uint32_t i = 0; i < count; ++i)
+		keys[i] = { items[i].key, i };
+
+	//One pass per byte, least significant first. A byte that is the same for every key leaves the order
+	//untouched, those passes are skipped, which is most of them for a frame's worth of draws.
+	for (int shift = 0; shift < 64; shift += 8)
+	{
+		std::array<size_t, 256> offsets{};
+		for (auto& key : keys)
+			offsets[(key.first >> shift) & 0xFF]++;
+
+		if (offsets[(keys.empty() ? 0 : keys[0].first >> shift) & 0xFF] == count)
+			continue;
+
+		size_t total = 0;
+		for (auto& offset : offsets)
+		{
+			auto bucketSize = offset;
+			offset = total;
+			total += bucketSize;
+		}
+
+		for (auto& key : keys)
+			swapKeys[offsets[(key.first >> shift) & 0xFF]++] = key;
+
+		keys.swap(swapKeys);
+	}
+
+	sorted.resize(count);
+	for (size_t i = 0; i < count; ++i)
+		sorted[i] = &items[keys[i].second];
+
+	return sorted;
+}
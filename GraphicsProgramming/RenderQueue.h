@@ -0,0 +1,87 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+class ShaderProgram;
+class Mesh;
+struct MultiDraw;
+
+//Passes are drawn in this order, the pass is the most significant part of the sort key.
+//The sky comes after the opaque pass so it only shades the pixels nothing else covered.
+enum class RenderPass : uint8_t
+{
+	DepthPrepass = 0,
+	Opaque,
+	Sky,
+	Transparent,
+};
+
+//A fixed set of textures bound to units 0..count-1. The sort id is the GL name of the first texture,
+//the same thing meshes use, so draws sharing textures sort next to each other.
+struct Material
+{
+	uint16_t sortId = 0;
+	GLenum target = GL_TEXTURE_2D;
+	unsigned int count = 0;
+	std::array<GLuint, 5> textures{};
+};
+
+struct DrawItem
+{
+	uint64_t key = 0;
+
+	const ShaderProgram* program = nullptr;
+	const Material* material = nullptr;
+	//Meshes bind their own textures and vertex array, only the units in textureUnits.
+	Mesh* mesh = nullptr;
+	uint32_t textureUnits = 0;
+	//Set for a glMultiDrawElementsBaseVertex over the vao instead of a single draw.
+	const MultiDraw* multiDraw = nullptr;
+
+	GLuint vao = 0;
+	GLsizei indexCount = 0;
+	GLsizei instanceCount = 1;
+	glm::mat4 world = glm::mat4(1.0f);
+
+	bool cullFace = true;
+	bool depthTest = true;
+	bool depthWrite = true;
+	bool colorWrite = true;
+	GLenum depthFunc = GL_LESS;
+
+	//GPU profiler zone, consecutive items with the same label are timed together.
+	const char* zone = "Draws";
+};
+
+//Draws are collected for the whole frame, sorted on a packed 64 bit key and then submitted in one go.
+//Key layout, most significant first: pass (4) | program (8) | material (12) | depth (24) | vao (16).
+//Within one program and material opaque draws go front to back so early-Z rejects hidden fragments,
+//transparent draws back to front.
+class RenderQueue
+{
+public:
+	static constexpr float maxSortDepth = 10000.0f;
+
+	static uint64_t make_key(RenderPass pass, GLuint program, uint16_t material, float viewDepth, GLuint vao);
+
+	void push(DrawItem&& item) { items.push_back(std::move(item)); }
+	void clear() { items.clear(); }
+
+	//LSD radix sort on the keys, returns the items in draw order. Valid until the next push or clear.
+	const std::vector<const DrawItem*>& sort();
+
+	size_t size() const { return items.size(); }
+
+private:
+	std::vector<DrawItem> items;
+
+	//Scratch storage, kept between frames so sorting doesn't allocate once the queue has warmed up.
+	std::vector<std::pair<uint64_t, uint32_t>> keys;
+	std::vector<std::pair<uint64_t, uint32_t>> swapKeys;
+	std::vector<const DrawItem*> sorted;
+};
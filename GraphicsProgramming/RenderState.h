@@ -0,0 +1,205 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <array>
+#include "RenderStats.h"
+
+enum class Capability
+{
+	DepthTest = 0,
+	CullFace,
+	Blend,
+	StencilTest,
+	PolygonOffsetFill,
+	Count
+};
+
+//Shadow copy of the GL state the renderer touches. Every setter compares against the last value it forwarded
+//and only calls GL when it differs, the skipped calls are counted in RenderStats::redundantStateChanges.
+//Anything that changes this state behind its back (uploads, texture loading) has to be followed by invalidate().
+class RenderState
+{
+public:
+	static constexpr GLuint maxTextureUnits = 16;
+
+	RenderState() { invalidate(); }
+
+	void use_program(GLuint program);
+	void bind_vertex_array(GLuint vao);
+	void bind_texture(GLuint unit, GLenum target, GLuint texture);
+	void set_enabled(Capability capability, bool enabled);
+	void cull_face(GLenum face);
+	void depth_func(GLenum func);
+	void depth_mask(bool write);
+	void color_mask(bool write);
+	void stencil_mask(GLuint mask);
+
+	//Forgets everything, the next call of each setter always reaches GL.
+	void invalidate();
+
+private:
+	static constexpr GLuint unknown = ~GLuint(0);
+	static constexpr GLenum capabilityEnums[] = { GL_DEPTH_TEST, GL_CULL_FACE, GL_BLEND, GL_STENCIL_TEST, GL_POLYGON_OFFSET_FILL };
+
+	struct TextureUnit
+	{
+		GLenum target = unknown;
+		GLuint texture = unknown;
+	};
+
+	void active_texture(GLuint unit);
+
+	GLuint program = unknown;
+	GLuint vertexArray = unknown;
+	GLuint activeUnit = unknown;
+	GLenum cullFace = unknown;
+	GLenum depthFunc = unknown;
+	GLuint depthWrite = unknown;
+	GLuint colorWrite = unknown;
+	GLuint stencilWrite = unknown;
+	std::array<TextureUnit, maxTextureUnits> textureUnits;
+
+	//0 disabled, 1 enabled, unknown otherwise.
+	std::array<GLuint, static_cast<size_t>(Capability::Count)> capabilities;
+};
+
+inline void RenderState::use_program(GLuint newProgram)
+{
+	if (program == newProgram)
+	{
+		RenderStats::shared_instance().redundantStateChanges++;
+		return;
+	}
+
+	glUseProgram(newProgram);
+	program = newProgram;
+	RenderStats::shared_instance().programBinds++;
+}
+
+inline void RenderState::bind_vertex_array(GLuint vao)
+{
+	if (vertexArray == vao)
+	{
+		RenderStats::shared_instance().redundantStateChanges++;
+		return;
+	}
+
+	glBindVertexArray(vao);
+	vertexArray = vao;
+}
+
+inline void RenderState::active_texture(GLuint unit)
+{
+	if (activeUnit == unit)
+		return;
+
+	glActiveTexture(GL_TEXTURE0 + unit);
+	activeUnit = unit;
+}
+
+inline void RenderState::bind_texture(GLuint unit, GLenum target, GLuint texture)
+{
+	auto& slot = textureUnits[unit];
+	if (slot.target == target && slot.texture == texture)
+	{
+		RenderStats::shared_instance().redundantStateChanges++;
+		return;
+	}
+
+	active_texture(unit);
+	glBindTexture(target, texture);
+	slot.target = target;
+	slot.texture = texture;
+	RenderStats::shared_instance().textureBinds++;
+}
+
+inline void RenderState::set_enabled(Capability capability, bool enabled)
+{
+	auto& current = capabilities[static_cast<size_t>(capability)];
+	if (current == static_cast<GLuint>(enabled))
+	{
+		RenderStats::shared_instance().redundantStateChanges++;
+		return;
+	}
+
+	if (enabled)
+		glEnable(capabilityEnums[static_cast<size_t>(capability)]);
+	else
+		glDisable(capabilityEnums[static_cast<size_t>(capability)]);
+	current = enabled;
+}
+
+inline void RenderState::cull_face(GLenum face)
+{
+	if (cullFace == face)
+	{
+		RenderStats::shared_instance().redundantStateChanges++;
+		return;
+	}
+
+	glCullFace(face);
+	cullFace = face;
+}
+
+inline void RenderState::depth_func(GLenum func)
+{
+	if (depthFunc == func)
+	{
+		RenderStats::shared_instance().redundantStateChanges++;
+		return;
+	}
+
+	glDepthFunc(func);
+	depthFunc = func;
+}
+
+inline void RenderState::depth_mask(bool write)
+{
+	if (depthWrite == static_cast<GLuint>(write))
+	{
+		RenderStats::shared_instance().redundantStateChanges++;
+		return;
+	}
+
+	glDepthMask(write ? GL_TRUE : GL_FALSE);
+	depthWrite = write;
+}
+
+inline void RenderState::color_mask(bool write)
+{
+	if (colorWrite == static_cast<GLuint>(write))
+	{
+		RenderStats::shared_instance().redundantStateChanges++;
+		return;
+	}
+
+	GLboolean mask = write ? GL_TRUE : GL_FALSE;
+	glColorMask(mask, mask, mask, mask);
+	colorWrite = write;
+}
+
+inline void RenderState::stencil_mask(GLuint mask)
+{
+	if (stencilWrite == mask)
+	{
+		RenderStats::shared_instance().redundantStateChanges++;
+		return;
+	}
+
+	glStencilMask(mask);
+	stencilWrite = mask;
+}
+
+inline void RenderState::invalidate()
+{
+	program = unknown;
+	vertexArray = unknown;
+	activeUnit = unknown;
+	cullFace = unknown;
+	depthFunc = unknown;
+	depthWrite = unknown;
+	colorWrite = unknown;
+	stencilWrite = unknown;
+	textureUnits.fill(TextureUnit());
+	capabilities.fill(unknown);
+}
\ No newline at end of file
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <ostream>
+
+//Per frame GL call counters, touched only from the thread that owns the GL context.
+//Reset once per frame, read before the reset to compare the cost of a change.
+struct RenderStats
+{
+	static RenderStats& shared_instance() { static RenderStats stats; return stats; }
+
+	unsigned int drawCalls = 0;
+	unsigned int instances = 0;
+	unsigned int programBinds = 0;
+	unsigned int textureBinds = 0;
+	unsigned int uniformLookups = 0;
+	unsigned int uniformUploads = 0;
+	unsigned int redundantStateChanges = 0;
+	unsigned int chunksUploaded = 0;
+	//Streamed chunk data only. The uniform blocks and instance matrices refilled every frame go in frameDataBytes.
+	unsigned int bytesUploaded = 0;
+	unsigned int frameDataBytes = 0;
+	unsigned int shadowCascadesRendered = 0;
+	unsigned int shadowCasters = 0;
+	unsigned int shadowCastersCulled = 0;
+	//Fragments that passed the depth test and the pixels on screen, filled in a frame late from an occlusion query.
+	unsigned int samplesPassed = 0;
+	unsigned int screenPixels = 0;
+
+	void reset() { *this = RenderStats(); }
+	void print(std::ostream& stream) const;
+};
+
+inline void RenderStats::print(std::ostream& stream) const
+{
+	stream << "Draw calls: " << drawCalls << ", instances: " << instances << ", program binds: " << programBinds << ", texture binds: " << textureBinds
+		<< ", uniform lookups: " << uniformLookups << ", uniform uploads: " << uniformUploads
+		<< ", redundant state changes filtered: " << redundantStateChanges << std::endl;
+	stream << "Chunks uploaded: " << chunksUploaded << ", bytes uploaded: " << bytesUploaded << ", per frame uniform and instance bytes: " << frameDataBytes << std::endl;
+	stream << "Shadow cascades rendered: " << shadowCascadesRendered << ", casters drawn: " << shadowCasters << ", culled: " << shadowCastersCulled << std::endl;
+
+	if (screenPixels > 0)
+		stream << "Samples passed: " << samplesPassed << ", overdraw: " << static_cast<double>(samplesPassed) / screenPixels << "x" << std::endl;
+}
\ No newline at end of file
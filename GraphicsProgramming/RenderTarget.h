@@ -0,0 +1,17 @@
+#pragma once
+
+#include <glad/glad.h>
+
+//Framebuffer with a colour texture and a depth/stencil renderbuffer, the same layout the window asks GLFW for.
+//The colour is a linear filtered texture so it can be sampled when scaling to the window.
+struct RenderTarget
+{
+	GLuint framebuffer = 0;
+	GLuint color = 0;
+	GLuint depthStencil = 0;
+	int width = 0;
+	int height = 0;
+
+	bool create(int targetWidth, int targetHeight);
+	void destroy();
+};
\ No newline at end of file
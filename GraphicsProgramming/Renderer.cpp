@@ -1,209 +1,627 @@
 #include "Renderer.h"
+#include "Profiler.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cstring>
+#include <thread>
 
-void Renderer::Intialize(GLuint& program)
+void Renderer::Intialize(ShaderProgram& program)
 {
-	createProgram(program, "Resources/Shaders/simpleVertexShader.glsl", "Resources/Shaders/simpleFragmentShader.glsl");
-
 	glUseProgram(program);
-	glUniform1i(glGetUniformLocation(program, "mainTex"), 0);
-	glUniform1i(glGetUniformLocation(program, "normalTex"), 1);
+	program.set_sampler("mainTex", 0);
+	program.set_sampler("normalTex", 1);
+
+	//Camera, sun and sky data is shared by every program through one uniform block.
+	glGenBuffers(1, &frameUniformBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, frameUniformBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), nullptr, GL_DYNAMIC_DRAW);
+	glBindBufferBase(GL_UNIFORM_BUFFER, frameDataBinding, frameUniformBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
 }
 
-void Renderer::render_cube(unsigned int& cubeProgram, WorldInformation& worldInformation, Cube& cube)
+void Renderer::begin_frame()
 {
-	glDisable(GL_CULL_FACE);
-	glEnable(GL_DEPTH);
-	glEnable(GL_DEPTH_TEST);
-	glCullFace(GL_BACK);
-
-	glUseProgram(cubeProgram);
+	//Queued uploads and texture loads bind buffers and textures directly, so nothing is carried over between frames.
+	state.invalidate();
 
-	glm::mat4 world = glm::mat4(1.0f);
-	world = glm::translate(world, glm::vec3(0, 100, 0));
-	world = world * glm::mat4_cast(glm::quat(glm::vec3(0, 0.5f, 0)));
-	world = glm::scale(world, glm::vec3(50));
+#if ENABLE_PROFILER
+	Profiler::shared_instance().collect_gpu();
+#endif
+}
 
-	process_uniforms(cubeProgram, worldInformation, world);
+void Renderer::update_frame_uniforms(WorldInformation& worldInformation)
+{
+	FrameUniforms frameUniforms;
+	frameUniforms.projection = worldInformation.projection;
+	frameUniforms.view = worldInformation.view;
+	frameUniforms.sunColor = glm::vec4(sunColor, 0.0f);
+	frameUniforms.topColor = glm::vec4(topColor, 0.0f);
+	frameUniforms.botColor = glm::vec4(botColor, 0.0f);
+	frameUniforms.lightDirection = glm::vec4(worldInformation.lightPosition, 0.0f);
+	frameUniforms.cameraPosition = glm::vec4(worldInformation.cameraPosition, 1.0f);
+
+	glBindBuffer(GL_UNIFORM_BUFFER, frameUniformBuffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniforms), &frameUniforms);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	RenderStats::shared_instance().uniformUploads++;
+	RenderStats::shared_instance().frameDataBytes += sizeof(FrameUniforms);
+}
 
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, cube.Textures[0]);
+void Renderer::create_materials(Cube& cube)
+{
+	terrainMaterial.count = 1;
+	terrainMaterial.target = GL_TEXTURE_2D_ARRAY;
+	terrainMaterial.textures[0] = terrainLayers;
+	terrainMaterial.sortId = static_cast<uint16_t>(terrainLayers);
+
+	cubeMaterial.count = 2;
+	cubeMaterial.textures[0] = cube.Textures[0];
+	cubeMaterial.textures[1] = cube.Textures[1];
+	cubeMaterial.sortId = static_cast<uint16_t>(cube.Textures[0]);
+}
 
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, cube.Textures[1]);
+void Renderer::submit_cube(ShaderProgram& cubeProgram, WorldInformation& worldInformation, Cube& cube)
+{
+	DrawItem item;
+	item.program = &cubeProgram;
+	item.material = &cubeMaterial;
+	item.vao = cube.VAO;
+	item.indexCount = cube.IndexSize;
+	item.cullFace = false;
+	item.zone = "Cube";
+
+	item.world = glm::translate(item.world, glm::vec3(0, 100, 0));
+	item.world = item.world * glm::mat4_cast(glm::quat(glm::vec3(0, 0.5f, 0)));
+	item.world = glm::scale(item.world, glm::vec3(50));
+
+	auto depth = glm::distance(glm::vec3(item.world[3]), worldInformation.cameraPosition);
+	item.key = RenderQueue::make_key(RenderPass::Opaque, cubeProgram, cubeMaterial.sortId, depth, item.vao);
+	queue.push(std::move(item));
+}
 
-	glBindVertexArray(cube.VAO);
-	glDrawElements(GL_TRIANGLES, cube.IndexSize, GL_UNSIGNED_INT, 0);
+void Renderer::initialize_shader_compiler(GLADloadproc loader)
+{
+	programCache.initialize(loader);
 
-	glUseProgram(0);
+	GLint extensionCount = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+	for (GLint i = 0; i < extensionCount; ++i)
+	{
+		auto extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+		if (std::strcmp(extension, "GL_KHR_parallel_shader_compile") == 0 || std::strcmp(extension, "GL_ARB_parallel_shader_compile") == 0)
+		{
+			auto maxShaderCompilerThreads = reinterpret_cast<void (APIENTRYP)(GLuint)>(loader("glMaxShaderCompilerThreadsKHR"));
+			if (maxShaderCompilerThreads == nullptr)
+				maxShaderCompilerThreads = reinterpret_cast<void (APIENTRYP)(GLuint)>(loader("glMaxShaderCompilerThreadsARB"));
+
+			//Let the driver pick how many threads it compiles on.
+			if (maxShaderCompilerThreads != nullptr)
+				maxShaderCompilerThreads(0xFFFFFFFF);
+
+			parallelShaderCompile = true;
+			break;
+		}
+	}
 }
 
-void Renderer::createProgram(GLuint& programId, const char* vertex, const char* fragment)
+static GLuint compile_shader(GLenum type, const char* source)
 {
-	auto vertexFuture = FileLoader::load_file_async(vertex);
-	auto fragmentFuture = FileLoader::load_file_async(fragment);
-
-	GLuint vertexShaderId, fragmentShaderId;
+	GLuint shader = glCreateShader(type);
+	glShaderSource(shader, 1, &source, nullptr);
+	glCompileShader(shader);
+	return shader;
+}
 
-	char infoLog[512];
+static bool report_shader_errors(GLuint shader, const char* path)
+{
 	int succes;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &succes);
+	if (succes)
+		return false;
 
-	char* vertexSrc = vertexFuture.get();
+	char infoLog[512];
+	glGetShaderInfoLog(shader, 512, nullptr, infoLog);
+	std::cout << "Compile Error, " << path << "\n" << infoLog << std::endl;
+	return true;
+}
 
-	if (vertexSrc == nullptr)
+void Renderer::create_programs(const std::vector<ProgramSource>& sources)
+{
+	struct PendingProgram
 	{
-		std::cout << "Failed to Load Vertex" << std::endl;
-	}
+		std::future<char*> vertexFile;
+		std::future<char*> fragmentFile;
+		char* vertexSrc = nullptr;
+		char* fragmentSrc = nullptr;
 
-	vertexShaderId = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertexShaderId, 1, &vertexSrc, nullptr);
-	glCompileShader(vertexShaderId);
+		std::uint64_t cacheKey = 0;
+		bool cached = false;
 
-	glGetShaderiv(vertexShaderId, GL_COMPILE_STATUS, &succes);
-	if (!succes)
-	{
-		glGetShaderInfoLog(vertexShaderId, 512, nullptr, infoLog);
-		std::cout << "Compile Error, Vertex Shader\n" << infoLog << std::endl;
-	}
+		GLuint vertexShader = 0;
+		GLuint fragmentShader = 0;
+		GLuint id = 0;
+	};
 
-	char* fragmentSrc = fragmentFuture.get();
+	std::vector<PendingProgram> pending(sources.size());
 
-	if (fragmentSrc == nullptr)
+	//Every file read is queued on the I/O lane before waiting on any of them.
+	for (size_t i = 0; i < sources.size(); ++i)
 	{
-		std::cout << "Failed to Load Fragment" << std::endl;
+		pending[i].vertexFile = FileLoader::load_file_async(sources[i].vertexPath);
+		pending[i].fragmentFile = FileLoader::load_file_async(sources[i].fragmentPath);
 	}
 
-	fragmentShaderId = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragmentShaderId, 1, &fragmentSrc, nullptr);
-	glCompileShader(fragmentShaderId);
-
-	glGetShaderiv(fragmentShaderId, GL_COMPILE_STATUS, &succes);
-	if (!succes)
+	//Issue every compile and link without asking for a result, a status query would wait for that one program.
+	for (size_t i = 0; i < sources.size(); ++i)
 	{
-		glGetShaderInfoLog(vertexShaderId, 512, nullptr, infoLog);
-		std::cout << "Compile Error, Fragment Shader\n" << infoLog << std::endl;
+		auto& program = pending[i];
+		program.vertexSrc = program.vertexFile.get();
+		program.fragmentSrc = program.fragmentFile.get();
+
+		if (program.vertexSrc == nullptr || program.fragmentSrc == nullptr)
+		{
+			std::cout << "Failed to Load Shader " << (program.vertexSrc == nullptr ? sources[i].vertexPath : sources[i].fragmentPath) << std::endl;
+			continue;
+		}
+
+		program.cacheKey = programCache.key(program.vertexSrc, program.fragmentSrc);
+		program.id = programCache.load(program.cacheKey);
+		if (program.id != 0)
+		{
+			program.cached = true;
+			continue;
+		}
+
+		program.vertexShader = compile_shader(GL_VERTEX_SHADER, program.vertexSrc);
+		program.fragmentShader = compile_shader(GL_FRAGMENT_SHADER, program.fragmentSrc);
+
+		program.id = glCreateProgram();
+		glAttachShader(program.id, program.vertexShader);
+		glAttachShader(program.id, program.fragmentShader);
+		programCache.prepare(program.id);
+		glLinkProgram(program.id);
 	}
 
-	programId = glCreateProgram();
-	glAttachShader(programId, vertexShaderId);
-	glAttachShader(programId, fragmentShaderId);
-	glLinkProgram(programId);
-
-	glGetProgramiv(programId, GL_LINK_STATUS, &succes);
-	if (!succes)
+	//With the extension the compiles run on driver threads, poll until all of them are done.
+	if (parallelShaderCompile)
 	{
-		glGetProgramInfoLog(programId, 512, nullptr, infoLog);
-		std::cout << "Program Linking Error" << infoLog << std::endl;
+		for (auto& program : pending)
+		{
+			if (program.id == 0 || program.cached)
+				continue;
+
+			GLint done = GL_FALSE;
+			while (glGetProgramiv(program.id, GL_COMPLETION_STATUS_KHR, &done), done == GL_FALSE)
+				std::this_thread::yield();
+		}
 	}
 
-	glDeleteShader(vertexShaderId);
-	glDeleteShader(fragmentShaderId);
-
-	delete(vertexSrc);
-	delete(fragmentSrc);
+	for (size_t i = 0; i < sources.size(); ++i)
+	{
+		auto& program = pending[i];
+
+		if (program.id != 0 && !program.cached)
+		{
+			bool failed = report_shader_errors(program.vertexShader, sources[i].vertexPath);
+			failed |= report_shader_errors(program.fragmentShader, sources[i].fragmentPath);
+
+			int succes;
+			glGetProgramiv(program.id, GL_LINK_STATUS, &succes);
+			if (!succes)
+			{
+				char infoLog[512];
+				glGetProgramInfoLog(program.id, 512, nullptr, infoLog);
+				std::cout << "Program Linking Error, " << sources[i].vertexPath << " + " << sources[i].fragmentPath << "\n" << infoLog << std::endl;
+			}
+			else if (!failed)
+			{
+				programCache.store(program.cacheKey, program.id);
+			}
+
+			glDeleteShader(program.vertexShader);
+			glDeleteShader(program.fragmentShader);
+		}
+
+		if (program.id != 0)
+		{
+			sources[i].program->id = program.id;
+			sources[i].program->reflect();
+		}
+
+		delete[] program.vertexSrc;
+		delete[] program.fragmentSrc;
+	}
 }
 
-void Renderer::render_skybox(unsigned int& skyProgram, WorldInformation& worldInformation, unsigned int skyboxVao, unsigned int skyBoxIndexSize)
+void Renderer::submit_skybox(ShaderProgram& skyProgram, WorldInformation& worldInformation, unsigned int skyboxVao, unsigned int skyBoxIndexSize)
 {
-	glDisable(GL_CULL_FACE);
-	glDisable(GL_DEPTH);
-	glDisable(GL_DEPTH_TEST);
+	DrawItem item;
+	item.program = &skyProgram;
+	item.vao = skyboxVao;
+	item.indexCount = skyBoxIndexSize;
+	item.cullFace = false;
+	item.depthWrite = false;
+	item.depthFunc = GL_LEQUAL;
+	item.zone = "Skybox";
+
+	item.world = glm::translate(item.world, worldInformation.cameraPosition);
+	item.world = glm::scale(item.world, glm::vec3(100.0f, 100.0f, 100.0f));
+
+	//The vertex shader puts the sky on the far plane, drawn after the opaque pass it only shades the uncovered pixels.
+	item.key = RenderQueue::make_key(RenderPass::Sky, skyProgram, 0, 0.0f, item.vao);
+	queue.push(std::move(item));
+}
 
-	glUseProgram(skyProgram);
+void Renderer::submit_model(Model* model, WorldInformation& worldInformation, glm::vec3 pos, glm::vec3 rotation, glm::vec3 scale)
+{
+	//Still loading on the UploadQueue.
+	if (!model->ready)
+		return;
 
 	glm::mat4 world = glm::mat4(1.0f);
-	world = glm::translate(world, worldInformation.cameraPosition);
-	world = glm::scale(world, glm::vec3(100.0f, 100.0f, 100.0f));
-
-	process_uniforms(skyProgram, worldInformation, world);
-
-	glBindVertexArray(skyboxVao);
-	glDrawElements(GL_TRIANGLES, skyBoxIndexSize, GL_UNSIGNED_INT, 0);
+	world = glm::translate(world, pos);
+	world = world * glm::mat4_cast(glm::quat(rotation));
+	world = glm::scale(world, scale);
 
-	glEnable(GL_DEPTH);
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_CULL_FACE);
+	auto& batch = modelInstances[model];
+	if (batch.matrices.empty())
+		batch.nearestDepth = RenderQueue::maxSortDepth;
 
-	glUseProgram(0);
+	batch.matrices.push_back(world);
+	batch.nearestDepth = std::min(batch.nearestDepth, glm::distance(pos, worldInformation.cameraPosition));
 }
 
-void Renderer::render_model(Model* model, unsigned int program, WorldInformation worldInformation, glm::vec3 pos, glm::vec3 rotation, glm::vec3 scale)
+void Renderer::submit_instances(ShaderProgram& program)
 {
-	//glEnable(GL_BLEND);
-	//Alpha Blend.
-	//glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	//Additive
-	//glBlendFunc(GL_ONE, GL_ONE);
-	//Sort Additive
-	//glBlendFunc(GL_ONE_MINUS_DST_COLOR, GL_ONE);
-	//Multiply
-	//glBlendFunc(GL_DST_COLOR, GL_ZERO);
-	//Double Multiply
-	//glBlendFunc(GL_DST_COLOR, GL_SRC_COLOR);
+	PROFILE_SCOPE("Submit models");
 
-	glEnable(GL_CULL_FACE);
-	glEnable(GL_DEPTH);
-	glEnable(GL_DEPTH_TEST);
-	glCullFace(GL_BACK);
+	//Texture types the program doesn't sample aren't bound, the mesh's default textures for them included.
+	uint32_t textureUnits = sampled_texture_units(program);
 
-	glUseProgram(program);
+	for (auto& [model, batch] : modelInstances)
+	{
+		if (batch.matrices.empty())
+			continue;
+
+		//Orphan and refill, the driver hands out fresh storage if last frame's draws still read the old one.
+		GLsizeiptr bytes = batch.matrices.size() * sizeof(glm::mat4);
+		glBindBuffer(GL_ARRAY_BUFFER, model->instanceBuffer);
+		glBufferData(GL_ARRAY_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, batch.matrices.data());
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		RenderStats::shared_instance().frameDataBytes += static_cast<unsigned int>(bytes);
+		instanceDraws.emplace_back(model, static_cast<GLsizei>(batch.matrices.size()));
+
+		//One item per mesh so meshes sharing textures end up next to each other, the first texture stands in for the material.
+		for (auto& mesh : model->meshes)
+		{
+			DrawItem item;
+			item.program = &program;
+			item.mesh = &mesh;
+			item.instanceCount = static_cast<GLsizei>(batch.matrices.size());
+			item.textureUnits = textureUnits;
+			item.zone = "Models";
+
+			uint16_t material = mesh.bindings.empty() ? 0 : static_cast<uint16_t>(mesh.bindings[0].texture);
+			item.key = RenderQueue::make_key(RenderPass::Opaque, program, material, batch.nearestDepth, mesh.VAO);
+			queue.push(std::move(item));
+		}
+
+		batch.matrices.clear();
+	}
+}
 
-	glm::mat4 world = glm::mat4(1.0f);
-	world = glm::translate(world, pos);
-	world = world * glm::mat4_cast(glm::quat(rotation));
-	world = glm::scale(world, scale);
+void Renderer::process_uniforms(const ShaderProgram& program, const glm::mat4& worldMatrix)
+{
+	//Everything else comes from the FrameData block, filled once per frame.
+	program.set(Uniform::World, worldMatrix);
+}
 
-	process_uniforms(program, worldInformation, world);
-	model->Draw(program);
+void Renderer::submit_chunk(const ChunkDraw& chunk, WorldInformation& worldInformation)
+{
+	terrainDraws.push_back(TerrainDraw{ glm::distance(chunk.position, worldInformation.cameraPosition), chunk.arenaSlot, chunk.boundsMin, chunk.boundsMax });
+}
 
-	glDisable(GL_BLEND);
+void Renderer::submit_terrain(ShaderProgram& terrainProgram, ShaderProgram& depthOnlyProgram)
+{
+	PROFILE_SCOPE("Submit terrain");
+
+	terrainArena.clear_draws();
+	if (terrainDraws.empty())
+		return;
+
+	//Front to back inside the multi draw as well, so the nearest chunks fill the depth buffer first.
+	std::sort(terrainDraws.begin(), terrainDraws.end());
+	for (auto& draw : terrainDraws)
+		terrainArena.add_draw(draw.slot);
+
+	//Chunk vertices are already in world space.
+	DrawItem item;
+	item.program = &terrainProgram;
+	item.material = &terrainMaterial;
+	item.vao = terrainArena.vao();
+	item.multiDraw = &terrainArena.draw_list();
+	item.zone = "Terrain";
+
+	if (depthPrepass)
+	{
+		DrawItem prepass = item;
+		prepass.program = &depthOnlyProgram;
+		prepass.material = nullptr;
+		prepass.colorWrite = false;
+		prepass.zone = "Terrain depth pre-pass";
+		prepass.key = RenderQueue::make_key(RenderPass::DepthPrepass, depthOnlyProgram, 0, 0.0f, prepass.vao);
+		queue.push(std::move(prepass));
+
+		//Both programs compute gl_Position the same invariant way, so the shading pass lands on exactly the stored depth.
+		item.depthFunc = GL_LEQUAL;
+		item.depthWrite = false;
+	}
+
+	item.key = RenderQueue::make_key(RenderPass::Opaque, terrainProgram, terrainMaterial.sortId, 0.0f, item.vao);
+	queue.push(std::move(item));
 }
 
-void Renderer::process_uniforms(unsigned int& program, WorldInformation& worldInformation, glm::mat4& worldMatrix)
+void Renderer::render_shadows(WorldInformation& worldInformation, ShaderProgram& terrainShadowProgram, ShaderProgram& modelShadowProgram)
 {
-	glUniformMatrix4fv(glGetUniformLocation(program, "world"), 1, GL_FALSE, glm::value_ptr(worldMatrix));
-	//V = value pointer, sturen referentie naar instance door.
-	glUniformMatrix4fv(glGetUniformLocation(program, "projection"), 1, GL_FALSE, glm::value_ptr(worldInformation.projection));
-	glUniformMatrix4fv(glGetUniformLocation(program, "view"), 1, GL_FALSE, glm::value_ptr(worldInformation.view));
+	PROFILE_SCOPE("Shadows");
+	auto& stats = RenderStats::shared_instance();
+
+	shadows.update(worldInformation);
+
+	//Depth only, the offset keeps lit surfaces from shadowing themselves where the map's resolution runs out.
+	state.set_enabled(Capability::DepthTest, true);
+	state.set_enabled(Capability::CullFace, false);
+	state.set_enabled(Capability::Blend, false);
+	state.set_enabled(Capability::StencilTest, false);
+	state.set_enabled(Capability::PolygonOffsetFill, true);
+	glPolygonOffset(2.0f, 4.0f);
+	state.depth_func(GL_LESS);
+	state.depth_mask(true);
+	state.color_mask(false);
+
+	static const char* cascadeZones[] = { "Shadow cascade 0", "Shadow cascade 1", "Shadow cascade 2" };
+#if ENABLE_PROFILER
+	static const char* casterCounters[] = { "Shadow cascade 0 casters", "Shadow cascade 1 casters", "Shadow cascade 2 casters" };
+	static const char* culledCounters[] = { "Shadow cascade 0 culled", "Shadow cascade 1 culled", "Shadow cascade 2 culled" };
+#endif
+	static_assert(std::size(cascadeZones) == ShadowCascades::cascadeCount);
+
+	//Needed before this frame's shadow draws, so it goes ahead of the chunk generation on the pool.
+	Parallel::parallelForJoin(0, ShadowCascades::cascadeCount, [&](int cascade)
+		{
+			PROFILE_SCOPE("Shadow culling");
+
+			auto& draws = shadowDraws[cascade];
+			draws.clear();
+			shadowCulled[cascade] = 0;
+			if (!shadows.needs_render(cascade))
+				return;
+
+			for (auto& draw : terrainDraws)
+			{
+				if (shadows.intersects(cascade, draw.boundsMin, draw.boundsMax))
+					terrainArena.add_draw(draws, draw.slot);
+				else
+					shadowCulled[cascade]++;
+			}
+		}, ThreadPool::shared_instance(), TaskPriority::FrameCritical);
+
+	for (int cascade = 0; cascade < ShadowCascades::cascadeCount; ++cascade)
+	{
+		if (!shadows.needs_render(cascade))
+			continue;
+
+		PROFILE_SCOPE(cascadeZones[cascade]);
+		PROFILE_GPU_SCOPE(cascadeZones[cascade]);
+		shadows.begin_cascade(cascade);
+
+		auto& draws = shadowDraws[cascade];
+		unsigned int culled = shadowCulled[cascade];
+
+		if (draws.size() > 0)
+		{
+			state.use_program(terrainShadowProgram);
+			terrainShadowProgram.set(Uniform::LightViewProjection, shadows.light_view_projection(cascade));
+			state.bind_vertex_array(terrainArena.vao());
+			glMultiDrawElementsBaseVertex(GL_TRIANGLES, draws.counts.data(), GL_UNSIGNED_INT, draws.offsets.data(), draws.size(), draws.baseVertices.data());
+			stats.drawCalls++;
+		}
+
+		//Models have no bounds yet, every instance is drawn into every cascade.
+		if (!instanceDraws.empty())
+		{
+			state.use_program(modelShadowProgram);
+			modelShadowProgram.set(Uniform::LightViewProjection, shadows.light_view_projection(cascade));
+			for (auto& [model, instanceCount] : instanceDraws)
+			{
+				for (auto& mesh : model->meshes)
+					mesh.DrawDepth(state, instanceCount);
+			}
+		}
+
+		unsigned int casters = static_cast<unsigned int>(draws.size() + instanceDraws.size());
+		stats.shadowCasters += casters;
+		stats.shadowCastersCulled += culled;
+		PROFILE_COUNTER(casterCounters[cascade], casters);
+		PROFILE_COUNTER(culledCounters[cascade], culled);
+	}
 
-	glUniform3fv(glGetUniformLocation(program, "sunColor"), 1, glm::value_ptr(sunColor));
+	state.set_enabled(Capability::PolygonOffsetFill, false);
+	state.color_mask(true);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-	glUniform3fv(glGetUniformLocation(program, "topColor"), 1, glm::value_ptr(topColor));
-	glUniform3fv(glGetUniformLocation(program, "botColor"), 1, glm::value_ptr(botColor));
+	shadows.upload();
+}
 
-	glUniform3fv(glGetUniformLocation(program, "lightDirection"), 1, glm::value_ptr(worldInformation.lightPosition));
-	glUniform3fv(glGetUniformLocation(program, "cameraPosition"), 1, glm::value_ptr(worldInformation.cameraPosition));
+void Renderer::initialize_overdraw(ShaderProgram& program)
+{
+	overdrawProgram = &program;
+	glGenQueries(samplesQueryCount, samplesQueries.data());
+	//The overlay builds its triangle from gl_VertexID, core profile still wants a vertex array bound.
+	glGenVertexArrays(1, &emptyVertexArray);
 }
 
-void Renderer::render_plane(unsigned int& planeProgram, Plane& plane, WorldInformation& worldInformation)
+void Renderer::flush()
 {
-	glEnable(GL_DEPTH);
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_CULL_FACE);
-	glCullFace(GL_BACK);
+	PROFILE_SCOPE("Flush");
+	auto& stats = RenderStats::shared_instance();
+
+#if ENABLE_PROFILER
+	//Items are sorted by pass and program, so a label's draws are next to each other and a new label closes the open zone.
+	auto& profiler = Profiler::shared_instance();
+	const char* openZone = nullptr;
+	int gpuZone = -1;
+#endif
+
+	//Oldest first, stop at the first one the GPU hasn't finished. Results that come back after measuring was turned off
+	//only free their query.
+	bool samplesRead = false;
+	while (samplesQueriesInFlight > 0)
+	{
+		size_t oldest = (nextSamplesQuery + samplesQueryCount - samplesQueriesInFlight) % samplesQueryCount;
 
-	glUseProgram(planeProgram);
+		GLint available = GL_FALSE;
+		glGetQueryObjectiv(samplesQueries[oldest], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			break;
 
-	glm::mat4 world = glm::mat4(1.0f);
-	world = glm::translate(world, plane.position);
+		glGetQueryObjectuiv(samplesQueries[oldest], GL_QUERY_RESULT, &lastSamplesPassed);
+		lastScreenPixels = samplesQueryPixels[oldest];
+		samplesQueriesInFlight--;
+		samplesRead = true;
+	}
 
-	process_uniforms(planeProgram, worldInformation, world);
+	samplesReady = measureSamples && (samplesReady || samplesRead);
+	if (samplesReady)
+	{
+		stats.samplesPassed = lastSamplesPassed;
+		stats.screenPixels = lastScreenPixels;
+	}
 
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, dirt);
+	//Skipped for a frame when every query is still in flight.
+	bool countSamples = measureSamples && samplesQueries[0] != 0 && samplesQueriesInFlight < samplesQueryCount;
+	if (countSamples)
+	{
+		GLint viewport[4];
+		glGetIntegerv(GL_VIEWPORT, viewport);
+		samplesQueryPixels[nextSamplesQuery] = static_cast<unsigned int>(viewport[2] * viewport[3]);
+		glBeginQuery(GL_SAMPLES_PASSED, samplesQueries[nextSamplesQuery]);
+	}
 
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, sand);
+	if (showOverdraw)
+	{
+		//Every fragment that passes the depth test adds one to its pixel's stencil value.
+		state.set_enabled(Capability::StencilTest, true);
+		glStencilFunc(GL_ALWAYS, 0, 0xFF);
+		glStencilOp(GL_KEEP, GL_KEEP, GL_INCR);
+	}
+	else
+	{
+		state.set_enabled(Capability::StencilTest, false);
+	}
+
+	//Read by the terrain and model shaders, above every material unit.
+	state.bind_texture(ShadowCascades::textureUnit, GL_TEXTURE_2D_ARRAY, shadows.texture());
+
+	for (auto* item : queue.sort())
+	{
+#if ENABLE_PROFILER
+		if (profiler.capturing() && item->zone != openZone)
+		{
+			if (gpuZone >= 0)
+				profiler.end_gpu(gpuZone);
+			gpuZone = profiler.begin_gpu(item->zone);
+			openZone = item->zone;
+		}
+#endif
+
+		state.set_enabled(Capability::CullFace, item->cullFace);
+		state.set_enabled(Capability::DepthTest, item->depthTest);
+		state.set_enabled(Capability::Blend, false);
+		state.cull_face(GL_BACK);
+		state.depth_func(item->depthFunc);
+		state.depth_mask(item->depthWrite);
+		state.color_mask(item->colorWrite);
+		//Only shaded fragments count as overdraw, the depth pre-pass is left out.
+		state.stencil_mask(item->colorWrite ? 0xFF : 0x00);
+
+		state.use_program(*item->program);
+		process_uniforms(*item->program, item->world);
+
+		if (item->mesh != nullptr)
+		{
+			item->mesh->Draw(state, item->instanceCount, item->textureUnits);
+			continue;
+		}
+
+		if (item->material != nullptr)
+		{
+			for (unsigned int unit = 0; unit < item->material->count; ++unit)
+				state.bind_texture(unit, item->material->target, item->material->textures[unit]);
+		}
+
+		state.bind_vertex_array(item->vao);
+
+		if (item->multiDraw != nullptr)
+		{
+			auto& draws = *item->multiDraw;
+			glMultiDrawElementsBaseVertex(GL_TRIANGLES, draws.counts.data(), GL_UNSIGNED_INT, draws.offsets.data(), draws.size(), draws.baseVertices.data());
+		}
+		else
+		{
+			glDrawElements(GL_TRIANGLES, item->indexCount, GL_UNSIGNED_INT, 0);
+		}
+		stats.drawCalls++;
+	}
+
+#if ENABLE_PROFILER
+	if (gpuZone >= 0)
+		profiler.end_gpu(gpuZone);
+#endif
+
+	if (countSamples)
+	{
+		glEndQuery(GL_SAMPLES_PASSED);
+		nextSamplesQuery = (nextSamplesQuery + 1) % samplesQueryCount;
+		samplesQueriesInFlight++;
+	}
+
+	//glClear honours the write masks, leave them all on for the next frame.
+	state.depth_mask(true);
+	state.color_mask(true);
+	state.stencil_mask(0xFF);
+
+	if (showOverdraw && overdrawProgram != nullptr)
+	{
+		PROFILE_GPU_SCOPE("Overdraw view");
+		draw_overdraw();
+	}
 
-	glActiveTexture(GL_TEXTURE2);
-	glBindTexture(GL_TEXTURE_2D, grass);
+	queue.clear();
+	terrainDraws.clear();
+	instanceDraws.clear();
+}
 
-	glActiveTexture(GL_TEXTURE3);
-	glBindTexture(GL_TEXTURE_2D, rock);
+void Renderer::draw_overdraw()
+{
+	state.set_enabled(Capability::DepthTest, false);
+	state.set_enabled(Capability::CullFace, false);
+	state.use_program(*overdrawProgram);
+	state.bind_vertex_array(emptyVertexArray);
+
+	//One full screen pass per count, the stencil test picks the pixels it colours. Blue is drawn once, red eight times or more.
+	glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+	for (int count = 1; count <= overdrawLevels; ++count)
+	{
+		glStencilFunc(count == overdrawLevels ? GL_LEQUAL : GL_EQUAL, count, 0xFF);
 
-	glActiveTexture(GL_TEXTURE4);
-	glBindTexture(GL_TEXTURE_2D, snow);
+		float heat = (count - 1) / float(overdrawLevels - 1);
+		glm::vec3 color = heat < 0.5f ? glm::mix(glm::vec3(0, 0, 1), glm::vec3(0, 1, 0), heat * 2.0f) : glm::mix(glm::vec3(0, 1, 0), glm::vec3(1, 0, 0), heat * 2.0f - 1.0f);
+		overdrawProgram->set(Uniform::Color, color);
+
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+	}
 
-	glBindVertexArray(plane.VAO);
-	glDrawElements(GL_TRIANGLES, plane.indices.size() * sizeof(unsigned int), GL_UNSIGNED_INT, 0);
-	glUseProgram(0);
+	state.set_enabled(Capability::StencilTest, false);
 }
\ No newline at end of file
@@ -6,8 +6,17 @@
 #include <fstream>
 #include "FileLoader.h"
 #include <iostream>
+#include <unordered_map>
 
 #include "Model.h"
+#include "ChunkBufferPool.h"
+#include "ShaderProgram.h"
+#include "RenderStats.h"
+#include "RenderState.h"
+#include "RenderQueue.h"
+#include "TerrainArena.h"
+#include "ProgramCache.h"
+#include "ShadowCascades.h"
 
 struct WorldInformation
 {
@@ -17,17 +26,42 @@ struct WorldInformation
 	glm::vec3 lightPosition = glm::vec3();
 };
 
+//std140 mirror of the FrameData block in the shaders, vec3s are padded to vec4.
+struct FrameUniforms
+{
+	glm::mat4 projection;
+	glm::mat4 view;
+	glm::vec4 sunColor;
+	glm::vec4 topColor;
+	glm::vec4 botColor;
+	glm::vec4 lightDirection;
+	glm::vec4 cameraPosition;
+};
+
 struct Plane
 {
-	std::vector<float> vertices;
-	std::vector<unsigned int> indices;
-	unsigned int VAO;
-	unsigned int EBO;
+	//Only set when CPU side height queries need the generated data, otherwise it goes back to the pool after upload.
+	ChunkBufferPool::Handle cpuData;
+
+	//Slot in the renderer's TerrainArena, -1 while the chunk is still being generated.
+	int arenaSlot = -1;
 	glm::vec3 position;
+	//World space box around the generated heights, for shadow caster culling.
+	glm::vec3 boundsMin = glm::vec3(0.0f);
+	glm::vec3 boundsMax = glm::vec3(0.0f);
 
 	std::vector<unsigned int> textures;
 };
 
+//A resident chunk as a frame sees it, copied out of its Plane into the frame packet.
+struct ChunkDraw
+{
+	int arenaSlot;
+	glm::vec3 position;
+	glm::vec3 boundsMin;
+	glm::vec3 boundsMax;
+};
+
 struct Cube
 {
 	glm::vec3 Position;
@@ -42,20 +76,127 @@ struct Cube
 	int IndexSize;
 };
 
+//GL_KHR_parallel_shader_compile, not in the 3.3 loader.
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+struct ProgramSource
+{
+	ShaderProgram* program;
+	const char* vertexPath;
+	const char* fragmentPath;
+};
+
 class Renderer
 {
 public:
-	void Intialize(GLuint& program);
-	void render_plane(unsigned int& planeProgram, Plane& plane, WorldInformation& worldInformation);
-	void render_cube(unsigned int& cubeProgram, WorldInformation& worldInformation, Cube& cube);
-	void render_skybox(unsigned int& skyProgram, WorldInformation& worldInformation, unsigned int skyboxVao, unsigned int skyBoxIndexSize);
-	void createProgram(GLuint& programId, const char* vertex, const char* fragment);
-	void render_model(Model* model, unsigned int program, WorldInformation worldInformation, glm::vec3 pos, glm::vec3 rotation, glm::vec3 scale);
-	void process_uniforms(unsigned int& program, WorldInformation& worldInformation, glm::mat4& worldMatrix);
+	//Expects the program to be created already, sets up its samplers and the per frame uniform buffer.
+	void Intialize(ShaderProgram& program);
+
+	//Sets up the program cache and, when the driver has it, parallel shader compilation. Call before creating programs.
+	void initialize_shader_compiler(GLADloadproc loader);
+	//Reads, compiles and links all programs as one batch, errors are still reported per program.
+	void create_programs(const std::vector<ProgramSource>& sources);
+	void process_uniforms(const ShaderProgram& program, const glm::mat4& worldMatrix);
+	void update_frame_uniforms(WorldInformation& worldInformation);
+	void begin_frame();
+
+	//Call once the terrain and cube textures are loaded.
+	void create_materials(Cube& cube);
+
+	//Queue draws for this frame, nothing reaches GL until flush.
+	void submit_chunk(const ChunkDraw& chunk, WorldInformation& worldInformation);
+	//All chunks submitted this frame go out as one multi draw.
+	//With depthPrepass set the chunks are first drawn depth only, so the terrain shader runs once per visible pixel.
+	void submit_terrain(ShaderProgram& terrainProgram, ShaderProgram& depthOnlyProgram);
+	void submit_cube(ShaderProgram& cubeProgram, WorldInformation& worldInformation, Cube& cube);
+	void submit_skybox(ShaderProgram& skyProgram, WorldInformation& worldInformation, unsigned int skyboxVao, unsigned int skyBoxIndexSize);
+	void submit_model(Model* model, WorldInformation& worldInformation, glm::vec3 pos, glm::vec3 rotation, glm::vec3 scale);
+	//Every copy of a model submitted this frame goes out as one instanced draw per mesh.
+	void submit_instances(ShaderProgram& program);
+
+	//Draws the shadow cascades that are out of date, after the submits and before the scene's framebuffer is bound.
+	//Casters are the terrain chunks and models submitted this frame, chunks are culled per cascade.
+	void render_shadows(WorldInformation& worldInformation, ShaderProgram& terrainShadowProgram, ShaderProgram& modelShadowProgram);
+
+	//Sorts the queued draws and submits them.
+	void flush();
+
+	//Sets up the occlusion queries that measure overdraw and the program that shows it.
+	void initialize_overdraw(ShaderProgram& program);
+	//A sample count has come back since measuring was turned on, or there are no queries to wait for.
+	bool samples_ready() const { return samplesQueries[0] == 0 || samplesReady; }
 
 	const glm::vec3 topColor = glm::vec3(68.0 / 255.0, 118.0 / 255.0, 189.0 / 255.0);
 	const glm::vec3 botColor = glm::vec3(188.0 / 255.0, 214.0 / 255.0, 231.0 / 255.0);
 	glm::vec3 sunColor = glm::vec3(1.0, 200.0 / 255.0, 50.0 / 255.0);
 
-	unsigned int dirt, sand, grass, rock, snow;
+	//Dirt, sand, grass, rock and snow, one layer each.
+	unsigned int terrainLayers;
+
+	bool depthPrepass = false;
+	//Colours every pixel by how many fragments passed the depth test there, needs a stencil buffer.
+	bool showOverdraw = false;
+	//Counts the fragments that pass the depth test, for the overdraw figure in RenderStats. Off, no query is issued.
+	bool measureSamples = false;
+
+	RenderState state;
+	TerrainArena terrainArena;
+	ShadowCascades shadows;
+	//Set up by initialize_shader_compiler, otherwise every program is compiled from source.
+	ProgramCache programCache;
+
+private:
+	//Stencil counts saturate at 255, everything from the last level up shares its colour.
+	static constexpr int overdrawLevels = 8;
+
+	void draw_overdraw();
+
+	GLuint frameUniformBuffer = 0;
+	bool parallelShaderCompile = false;
+
+	ShaderProgram* overdrawProgram = nullptr;
+	GLuint emptyVertexArray = 0;
+	//Enough in flight that the oldest has finished by the time it's polled, the render thread runs ahead of the GPU.
+	static constexpr size_t samplesQueryCount = 4;
+	std::array<GLuint, samplesQueryCount> samplesQueries{};
+	std::array<unsigned int, samplesQueryCount> samplesQueryPixels{};
+	size_t nextSamplesQuery = 0;
+	size_t samplesQueriesInFlight = 0;
+	//The latest finished query, repeated into RenderStats every frame until a newer one comes back.
+	bool samplesReady = false;
+	unsigned int lastSamplesPassed = 0;
+	unsigned int lastScreenPixels = 0;
+
+	RenderQueue queue;
+	Material terrainMaterial;
+	Material cubeMaterial;
+
+	struct TerrainDraw
+	{
+		float depth;
+		int slot;
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+
+		bool operator<(const TerrainDraw& other) const { return depth < other.depth; }
+	};
+
+	//Every chunk submitted this frame, the shadow pass reads them after the scene's multi draw is built.
+	std::vector<TerrainDraw> terrainDraws;
+	//Models and their instance counts submitted this frame, the instance buffers stay filled until the next submit.
+	std::vector<std::pair<Model*, GLsizei>> instanceDraws;
+	//Per cascade, culled on the thread pool before any of them is drawn.
+	std::array<MultiDraw, ShadowCascades::cascadeCount> shadowDraws;
+	std::array<unsigned int, ShadowCascades::cascadeCount> shadowCulled{};
+
+	struct InstanceBatch
+	{
+		std::vector<glm::mat4> matrices;
+		float nearestDepth = 0.0f;
+	};
+
+	//Kept between frames so the matrix lists keep their capacity.
+	std::unordered_map<Model*, InstanceBatch> modelInstances;
 };
\ No newline at end of file
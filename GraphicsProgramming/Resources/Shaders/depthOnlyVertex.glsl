@@ -0,0 +1,27 @@
+#version 330 core
+layout(location = 0) in vec3 aPos;
+
+uniform mat4 world;
+
+layout(std140) uniform FrameData
+{
+	mat4 projection;
+	mat4 view;
+	vec3 sunColor;
+	vec3 topColor;
+	vec3 botColor;
+	vec3 lightDirection;
+	vec3 cameraPosition;
+};
+
+//Same expression as simpleTerrainVertex.glsl, so the shading pass can test with GL_LEQUAL against this depth.
+invariant gl_Position;
+
+void main()
+{
+	vec3 pos = aPos;
+
+	vec4 worldPos = world * vec4(pos, 1.0);
+
+	gl_Position = projection * view * worldPos;
+}
\ No newline at end of file
@@ -11,20 +11,49 @@ uniform sampler2D texture_normal1;
 uniform sampler2D texture_roughness1;
 uniform sampler2D texture_ao1;
 
-uniform vec3 cameraPosition;
-uniform vec3 lightDirection;
+layout(std140) uniform FrameData
+{
+	mat4 projection;
+	mat4 view;
+	vec3 sunColor;
+	vec3 topColor;
+	vec3 botColor;
+	vec3 lightDirection;
+	vec3 cameraPosition;
+};
+
+//See ShadowCascades::upload.
+layout(std140) uniform ShadowData
+{
+	mat4 lightViewProjection[3];
+	vec4 cascadeSplits;
+	vec4 cascadeTexelSizes;
+};
+
+uniform sampler2DArrayShadow shadowMap;
+
+//1 where the sun reaches the point, 0 in shadow, filtered in between.
+float shadow(vec3 position, vec3 normal)
+{
+	float depth = -(view * vec4(position, 1.0f)).z;
+	if (depth > cascadeSplits.z)
+		return 1.0f;
 
-uniform vec3 topColor;
-uniform vec3 botColor;
+	int cascade = depth < cascadeSplits.x ? 0 : (depth < cascadeSplits.y ? 1 : 2);
 
-uniform vec3 sunColor;
+	//Pushed out along the normal by a texel and a half, so surfaces don't shadow themselves.
+	vec3 offsetPosition = position + normal * cascadeTexelSizes[cascade] * 1.5f;
+	vec3 shadowPosition = (lightViewProjection[cascade] * vec4(offsetPosition, 1.0f)).xyz * 0.5f + 0.5f;
+	return texture(shadowMap, vec4(shadowPosition.xy, cascade, shadowPosition.z));
+}
 
 void main()
 {
 	vec4 diffuse = texture(texture_diffuse1, TexCoords);
 	vec4 specTex = texture(texture_specular1, TexCoords);
 
-	float light = max(-dot(lightDirection, Normals), 0.0);
+	float lit = shadow(FragPos.xyz, Normals);
+	float light = max(-dot(lightDirection, Normals), 0.0) * lit;
 
 	vec3 viewDir = normalize(FragPos.rgb - cameraPosition);
 	vec3 refl = reflect(lightDirection, Normals);
@@ -41,12 +70,12 @@ void main()
 
 	float roughness = texture(texture_roughness1, TexCoords).r;
 	float spec = pow(max(-dot(viewDir, refl), 0.0), mix(1, 128, roughness));
-	vec3 specular = spec * specTex.rgb;
+	vec3 specular = spec * specTex.rgb * lit;
 
-	vec4 output = mix(diffuse * vec4(sunColor, 1.0f) * max(light * ambientOcclusion, 0.2 * ambientOcclusion) + vec4(specular, 0), vec4(fogColor, 1.0f), fog);
+	vec4 outColor = mix(diffuse * vec4(sunColor, 1.0f) * max(light * ambientOcclusion, 0.2 * ambientOcclusion) + vec4(specular, 0), vec4(fogColor, 1.0f), fog);
 
 	//Clip at treshhold.
-	//if (output.a < 0.5) discard;
+	//if (outColor.a < 0.5) discard;
 
-	FragColor = output;
+	FragColor = outColor;
 }
\ No newline at end of file
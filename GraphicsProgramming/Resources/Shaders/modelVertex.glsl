@@ -1,22 +1,33 @@
 #version 330 core
+//Full float or packed vertices, see Mesh::setupVertexArray. Packed normals arrive as 10 bit snorm, close to but not
+//exactly unit length, the normalize below takes care of that.
 layout(location = 0) in vec3 aPos;
 layout(location = 1) in vec3 aNormal;
 layout(location = 2) in vec2 aTexCoords;
+//Per instance, see Mesh::setupInstancing.
+layout(location = 7) in mat4 instanceWorld;
 
 out vec2 TexCoords;
 out vec3 Normals;
 out vec4 FragPos;
 
-uniform mat4 world;
-uniform mat4 view;
-uniform mat4 projection;
+layout(std140) uniform FrameData
+{
+	mat4 projection;
+	mat4 view;
+	vec3 sunColor;
+	vec3 topColor;
+	vec3 botColor;
+	vec3 lightDirection;
+	vec3 cameraPosition;
+};
 
 void main()
 {
 	TexCoords = aTexCoords;
-	FragPos = world * vec4(aPos, 1.0);
+	FragPos = instanceWorld * vec4(aPos, 1.0);
 	gl_Position = projection * view * FragPos;
 
 	// not the most efficient, but it works
-	Normals = normalize(mat3(inverse(transpose(world))) * aNormal);
+	Normals = normalize(mat3(inverse(transpose(instanceWorld))) * aNormal);
 }
\ No newline at end of file
@@ -0,0 +1,11 @@
+#version 330 core
+layout(location = 0) in vec3 aPos;
+//Per instance, see Mesh::setupInstancing.
+layout(location = 7) in mat4 instanceWorld;
+
+uniform mat4 lightViewProjection;
+
+void main()
+{
+	gl_Position = lightViewProjection * instanceWorld * vec4(aPos, 1.0);
+}
\ No newline at end of file
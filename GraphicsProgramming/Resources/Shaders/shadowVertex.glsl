@@ -0,0 +1,10 @@
+#version 330 core
+layout(location = 0) in vec3 aPos;
+
+//Set per cascade, see Renderer::render_shadows. Chunk vertices are already in world space.
+uniform mat4 lightViewProjection;
+
+void main()
+{
+	gl_Position = lightViewProjection * vec4(aPos, 1.0);
+}
\ No newline at end of file
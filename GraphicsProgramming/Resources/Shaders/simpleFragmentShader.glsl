@@ -9,13 +9,16 @@ in vec3 worldPosition;
 uniform sampler2D mainTex;
 uniform sampler2D normalTex;
 
-uniform vec3 lightDirection;
-uniform vec3 cameraPosition;
-
-uniform vec3 topColor;
-uniform vec3 botColor;
-
-uniform vec3 sunColor;
+layout(std140) uniform FrameData
+{
+	mat4 projection;
+	mat4 view;
+	vec3 sunColor;
+	vec3 topColor;
+	vec3 botColor;
+	vec3 lightDirection;
+	vec3 cameraPosition;
+};
 
 void main()
 {
@@ -42,8 +45,8 @@ void main()
 	const float fogMult = 1.0 / 1000.0;
 	float fog = pow(clamp((dist - 250) * fogMult, 0.0, 1.0), 2.0);
 
-	vec4 output = vec4(color, 1.0f) * texture(mainTex, uv);
-	output.rgb = mix((output.rgb * sunColor * min(light + 0.2f, 1.0f) + specular), fogColor, fog);
+	vec4 outColor = vec4(color, 1.0f) * texture(mainTex, uv);
+	outColor.rgb = mix((outColor.rgb * sunColor * min(light + 0.2f, 1.0f) + specular), fogColor, fog);
 
-	FragColor = output;
+	FragColor = outColor;
 }
\ No newline at end of file
@@ -4,60 +4,91 @@ out vec4 FragColor;
 in vec2 uv;
 in vec3 normal;
 in vec4 worldPosition;
+//Sand, grass, rock and snow weights, dirt takes the rest.
+in vec4 splat;
 
-uniform sampler2D dirt, sand, grass, rock, snow;
+//Dirt, sand, grass, rock and snow.
+uniform sampler2DArray layers;
 
-uniform vec3 lightDirection;
-uniform vec3 cameraPosition;
+layout(std140) uniform FrameData
+{
+	mat4 projection;
+	mat4 view;
+	vec3 sunColor;
+	vec3 topColor;
+	vec3 botColor;
+	vec3 lightDirection;
+	vec3 cameraPosition;
+};
+
+//See ShadowCascades::upload.
+layout(std140) uniform ShadowData
+{
+	mat4 lightViewProjection[3];
+	vec4 cascadeSplits;
+	vec4 cascadeTexelSizes;
+};
 
-uniform vec3 topColor;
-uniform vec3 botColor;
+uniform sampler2DArrayShadow shadowMap;
+
+//1 where the sun reaches the point, 0 in shadow, filtered in between.
+float shadow(vec3 position, vec3 normal)
+{
+	float depth = -(view * vec4(position, 1.0f)).z;
+	if (depth > cascadeSplits.z)
+		return 1.0f;
+
+	int cascade = depth < cascadeSplits.x ? 0 : (depth < cascadeSplits.y ? 1 : 2);
+
+	//Pushed out along the normal by a texel and a half, so surfaces don't shadow themselves.
+	vec3 offsetPosition = position + normal * cascadeTexelSizes[cascade] * 1.5f;
+	vec3 shadowPosition = (lightViewProjection[cascade] * vec4(offsetPosition, 1.0f)).xyz * 0.5f + 0.5f;
+	return texture(shadowMap, vec4(shadowPosition.xy, cascade, shadowPosition.z));
+}
 
 uniform float nearField;
 uniform float farField;
 
-uniform vec3 sunColor;
-
 void main()
 {
 	vec3 viewDirection = normalize(worldPosition.rgb - cameraPosition);
 	vec3 reflDir = normalize(reflect(lightDirection, normal));
 
-	float light = max(-dot(normal, lightDirection), 0.0f);
-	float specular = pow(max(-dot(reflDir, viewDirection), 0.0f), 128);
-
-	//color weights
-	float y = worldPosition.y;
-	float ds = clamp((y + 25) * 0.1f, 0.0f, 1.0f);
-	float sg = clamp(y * 0.1f, 0.0f, 1.0);
-	float gr = clamp((y - 25) * 0.1f, 0.0f, 1.0f);
-	float rs = clamp((y - 50) * 0.1f, 0.0f, 1.0f);
+	float lit = shadow(worldPosition.xyz, normal);
+	float light = max(-dot(normal, lightDirection), 0.0f) * lit;
+	float specular = pow(max(-dot(reflDir, viewDirection), 0.0f), 128) * lit;
 
 	float dist = length(worldPosition.xyz - cameraPosition);
 
 	const float uvMult = 1.0 / 150.0f;
 	float uvLerp = clamp((dist - 250) * uvMult, 0.0f, 1.0f);
 
-	// lerp between close and far colors in a loop
-	vec3 colors[5];
-	vec3 colorsClose[5] = vec3[](
-		texture(dirt, uv * 100.0f).rgb,
-		texture(sand, uv * 100.0f).rgb,
-		texture(grass, uv * 100.0f).rgb,
-		texture(rock, uv * 100.0f).rgb,
-		texture(snow, uv * 100.0f).rgb
-		);
-
-	vec3 colorsFar[5] = vec3[](
-		texture(dirt, uv * 10.0f).rgb,
-		texture(sand, uv * 10.0f).rgb,
-		texture(grass, uv * 10.0f).rgb,
-		texture(rock, uv * 10.0f).rgb,
-		texture(snow, uv * 10.0f).rgb
-		);
-
-	for (int i = 0; i < 5; ++i) {
-		colors[i] = mix(colorsClose[i], colorsFar[i], uvLerp);
+	float weights[5] = float[](max(1.0f - dot(splat, vec4(1.0f)), 0.0f), splat.x, splat.y, splat.z, splat.w);
+
+	//Derivatives are taken up front, the fetches below sit in non uniform branches.
+	vec2 uvClose = uv * 100.0f;
+	vec2 uvFar = uv * 10.0f;
+	vec2 dxClose = dFdx(uvClose), dyClose = dFdy(uvClose);
+	vec2 dxFar = dFdx(uvFar), dyFar = dFdy(uvFar);
+
+	//Only layers with weight are fetched, that's one or two almost everywhere, and only the scales that are visible.
+	vec3 diffuse = vec3(0.0f);
+	for (int i = 0; i < 5; ++i)
+	{
+		if (weights[i] < 1.0f / 255.0f)
+			continue;
+
+		vec3 layerColor = vec3(0.0f);
+		if (uvLerp < 1.0f)
+			layerColor += textureGrad(layers, vec3(uvClose, i), dxClose, dyClose).rgb * (1.0f - uvLerp);
+		if (uvLerp > 0.0f)
+			layerColor += textureGrad(layers, vec3(uvFar, i), dxFar, dyFar).rgb * uvLerp;
+
+		//Dirt and rock are shiny.
+		if (i == 0 || i == 3)
+			layerColor += specular * layerColor;
+
+		diffuse += layerColor * weights[i];
 	}
 
 	// Calculate fog color
@@ -66,9 +97,6 @@ void main()
 	const float fogMult = 1.0f / 1000.0f;
 	float fog = pow(clamp((dist - 250) * fogMult, 0.0f, 1.0f), 2.0f);
 
-	// Blend the textures based on weights. Mix linearly interpolates.
-	vec3 diffuse = mix(mix(mix(mix(colors[0] + specular * colors[0], colors[1], ds), colors[2], sg), colors[3] + specular * colors[3], gr), colors[4], rs);
-
 	diffuse *= (sunColor * min(light + 0.2f, 1.0f));
 	vec3 color = mix(diffuse, fogColor, fog);
 	FragColor = vec4(color, 1.0f);
@@ -2,14 +2,30 @@
 layout(location = 0) in vec3 aPos;
 layout(location = 1) in vec3 vNormal;
 layout(location = 2) in vec2 vUv;
+layout(location = 3) in vec4 vSplat;
 
 out vec2 uv;
 out vec3 normal;
 out vec4 worldPosition;
+out vec4 splat;
+
+//Must match depthOnlyVertex.glsl bit for bit for the depth pre-pass.
+invariant gl_Position;
 
 uniform sampler2D mainTex;
 
-uniform mat4 world, view, projection;
+uniform mat4 world;
+
+layout(std140) uniform FrameData
+{
+	mat4 projection;
+	mat4 view;
+	vec3 sunColor;
+	vec3 topColor;
+	vec3 botColor;
+	vec3 lightDirection;
+	vec3 cameraPosition;
+};
 
 void main()
 {
@@ -21,6 +37,7 @@ void main()
 	
 	uv = vUv;
 	normal = vNormal;
+	splat = vSplat;
 
 	worldPosition = worldPos;
 }
\ No newline at end of file
@@ -11,7 +11,18 @@ out vec2 uv;
 out mat3 tbn;
 out vec3 worldPosition;
 
-uniform mat4 world, view, projection;
+uniform mat4 world;
+
+layout(std140) uniform FrameData
+{
+	mat4 projection;
+	mat4 view;
+	vec3 sunColor;
+	vec3 topColor;
+	vec3 botColor;
+	vec3 lightDirection;
+	vec3 cameraPosition;
+};
 
 void main()
 {
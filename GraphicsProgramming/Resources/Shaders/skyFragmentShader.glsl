@@ -3,13 +3,16 @@ out vec4 FragColor;
 
 in vec4 worldPosition;
 
-uniform vec3 lightDirection;
-uniform vec3 cameraPosition;
-
-uniform vec3 topColor;
-uniform vec3 botColor;
-
-uniform vec3 sunColor;
+layout(std140) uniform FrameData
+{
+	mat4 projection;
+	mat4 view;
+	vec3 sunColor;
+	vec3 topColor;
+	vec3 botColor;
+	vec3 lightDirection;
+	vec3 cameraPosition;
+};
 
 void main()
 {
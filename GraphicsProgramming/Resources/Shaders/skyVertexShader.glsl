@@ -3,12 +3,24 @@ layout(location = 0) in vec3 aPos;
 
 out vec4 worldPosition;
 
-uniform mat4 world, view, projection;
+uniform mat4 world;
+
+layout(std140) uniform FrameData
+{
+	mat4 projection;
+	mat4 view;
+	vec3 sunColor;
+	vec3 topColor;
+	vec3 botColor;
+	vec3 lightDirection;
+	vec3 cameraPosition;
+};
 
 void main()
 {
 	//Object naar world, naar camera, naar clip space.
-	gl_Position = projection * view * world * vec4(aPos, 1.0);
+	//z = w puts the sky on the far plane, it's drawn after the opaque pass with GL_LEQUAL.
+	gl_Position = (projection * view * world * vec4(aPos, 1.0)).xyww;
 
 	worldPosition = world * vec4(aPos, 1.0f);
 }
\ No newline at end of file
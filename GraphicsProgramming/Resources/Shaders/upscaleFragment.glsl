@@ -0,0 +1,32 @@
+#version 330 core
+in vec2 uv;
+out vec4 FragColor;
+
+uniform sampler2D scene;
+
+//Rendered part of the scene texture in uv, and the size of one of its texels.
+uniform vec2 uvScale;
+uniform vec2 texelSize;
+uniform float sharpness;
+
+void main()
+{
+	//Stay half a texel inside the rendered part, the rest of the texture holds stale pixels.
+	vec2 sceneUv = clamp(uv * uvScale, texelSize * 0.5, uvScale - texelSize * 0.5);
+
+	vec3 center = texture(scene, sceneUv).rgb;
+	if (sharpness <= 0.0)
+	{
+		FragColor = vec4(center, 1.0);
+		return;
+	}
+
+	//Unsharp mask, push the bilinear result away from the average of its neighbours.
+	vec3 neighbours = texture(scene, sceneUv + vec2(texelSize.x, 0.0)).rgb;
+	neighbours += texture(scene, sceneUv - vec2(texelSize.x, 0.0)).rgb;
+	neighbours += texture(scene, sceneUv + vec2(0.0, texelSize.y)).rgb;
+	neighbours += texture(scene, sceneUv - vec2(0.0, texelSize.y)).rgb;
+
+	vec3 sharpened = center + (center - neighbours * 0.25) * sharpness;
+	FragColor = vec4(clamp(sharpened, 0.0, 1.0), 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,10 @@
+#version 330 core
+out vec2 uv;
+
+//One triangle that covers the screen, no vertex buffer needed.
+void main()
+{
+	vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+	uv = corner;
+	gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
\ No newline at end of file
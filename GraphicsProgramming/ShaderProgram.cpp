@@ -0,0 +1,106 @@
+#include "ShaderProgram.h"
+
+#include <cstring>
+#include <glm/gtc/type_ptr.hpp>
+#include "RenderStats.h"
+
+static const char* builtinNames[] = { "world", "color", "lightViewProjection" };
+
+static bool is_sampler(GLenum type)
+{
+	switch (type)
+	{
+	case GL_SAMPLER_1D: case GL_SAMPLER_2D: case GL_SAMPLER_3D: case GL_SAMPLER_CUBE:
+	case GL_SAMPLER_2D_SHADOW: case GL_SAMPLER_2D_ARRAY: case GL_SAMPLER_2D_ARRAY_SHADOW:
+	case GL_INT_SAMPLER_2D: case GL_UNSIGNED_INT_SAMPLER_2D:
+		return true;
+	default:
+		return false;
+	}
+}
+
+void ShaderProgram::reflect()
+{
+	uniforms.clear();
+	builtinLocations.fill(-1);
+
+	GLint count = 0, maxLength = 0;
+	glGetProgramiv(id, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+	std::vector<char> nameBuffer(maxLength + 1);
+	uniforms.reserve(count);
+
+	for (GLint i = 0; i < count; ++i)
+	{
+		GLsizei length = 0;
+		UniformInfo info{};
+		glGetActiveUniform(id, i, static_cast<GLsizei>(nameBuffer.size()), &length, &info.size, &info.type, nameBuffer.data());
+
+		//Arrays are reported as "name[0]", store them by their plain name.
+		info.name.assign(nameBuffer.data(), length);
+		if (auto bracket = info.name.find('['); bracket != std::string::npos)
+			info.name.resize(bracket);
+
+		//Members of uniform blocks have no location.
+		info.location = glGetUniformLocation(id, nameBuffer.data());
+		RenderStats::shared_instance().uniformLookups++;
+		if (info.location < 0)
+			continue;
+
+		info.sampler = is_sampler(info.type);
+		uniforms.push_back(std::move(info));
+	}
+
+	for (size_t i = 0; i < builtinLocations.size(); ++i)
+		builtinLocations[i] = find_location(builtinNames[i]);
+
+	//GLSL 3.30 can't declare the binding in the shader.
+	GLuint frameDataIndex = glGetUniformBlockIndex(id, "FrameData");
+	if (frameDataIndex != GL_INVALID_INDEX)
+		glUniformBlockBinding(id, frameDataIndex, frameDataBinding);
+
+	GLuint shadowDataIndex = glGetUniformBlockIndex(id, "ShadowData");
+	if (shadowDataIndex != GL_INVALID_INDEX)
+		glUniformBlockBinding(id, shadowDataIndex, shadowDataBinding);
+}
+
+GLint ShaderProgram::find_location(const char* name) const
+{
+	for (auto& uniform : uniforms)
+	{
+		if (std::strcmp(uniform.name.c_str(), name) == 0)
+			return uniform.location;
+	}
+	return -1;
+}
+
+void ShaderProgram::set(Uniform uniform, const glm::mat4& value) const
+{
+	GLint uniformLocation = location(uniform);
+	if (uniformLocation < 0)
+		return;
+
+	glUniformMatrix4fv(uniformLocation, 1, GL_FALSE, glm::value_ptr(value));
+	RenderStats::shared_instance().uniformUploads++;
+}
+
+void ShaderProgram::set(Uniform uniform, const glm::vec3& value) const
+{
+	GLint uniformLocation = location(uniform);
+	if (uniformLocation < 0)
+		return;
+
+	glUniform3fv(uniformLocation, 1, glm::value_ptr(value));
+	RenderStats::shared_instance().uniformUploads++;
+}
+
+void ShaderProgram::set_sampler(const char* name, int unit) const
+{
+	GLint uniformLocation = find_location(name);
+	if (uniformLocation < 0)
+		return;
+
+	glUniform1i(uniformLocation, unit);
+	RenderStats::shared_instance().uniformUploads++;
+}
\ No newline at end of file
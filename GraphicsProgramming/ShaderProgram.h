@@ -0,0 +1,56 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <array>
+#include <string>
+#include <vector>
+
+//Per object uniforms, resolved once at link time so drawing never looks them up by name.
+enum class Uniform
+{
+	World = 0,
+	Color,
+	LightViewProjection,
+	Count
+};
+
+//Binding point of the FrameData uniform block, see Renderer::update_frame_uniforms.
+constexpr GLuint frameDataBinding = 0;
+//Binding point of the ShadowData uniform block, see ShadowCascades::upload.
+constexpr GLuint shadowDataBinding = 1;
+
+struct UniformInfo
+{
+	std::string name;
+	GLint location;
+	GLenum type;
+	GLint size;
+	bool sampler;
+};
+
+class ShaderProgram
+{
+public:
+	GLuint id = 0;
+
+	//Reads every active uniform with glGetActiveUniform into the location table and binds the FrameData and ShadowData blocks,
+	//call after a successful link.
+	void reflect();
+
+	GLint location(Uniform uniform) const { return builtinLocations[static_cast<size_t>(uniform)]; }
+	GLint find_location(const char* name) const;
+	const std::vector<UniformInfo>& active_uniforms() const { return uniforms; }
+
+	//Expect the program to be bound. Uniforms the program doesn't use are skipped.
+	void set(Uniform uniform, const glm::mat4& value) const;
+	void set(Uniform uniform, const glm::vec3& value) const;
+	void set_sampler(const char* name, int unit) const;
+
+	operator GLuint() const { return id; }
+
+private:
+	std::vector<UniformInfo> uniforms;
+	std::array<GLint, static_cast<size_t>(Uniform::Count)> builtinLocations{};
+};
\ No newline at end of file
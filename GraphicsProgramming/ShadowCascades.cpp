@@ -0,0 +1,176 @@
+#include "ShadowCascades.h"
+#include "Renderer.h"
+#include "ShaderProgram.h"
+#include "RenderStats.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <limits>
+#include <iostream>
+#include <cmath>
+
+void ShadowCascades::initialize(const glm::mat4& projection)
+{
+	//Backed out of a glm::perspective matrix.
+	float nearPlane = projection[3][2] / (projection[2][2] - 1.0f);
+	float tanHalfFovX = 1.0f / projection[0][0];
+	float tanHalfFovY = 1.0f / projection[1][1];
+	float cornerSlope2 = tanHalfFovX * tanHalfFovX + tanHalfFovY * tanHalfFovY;
+
+	float splitNear = nearPlane;
+	for (int i = 0; i < cascadeCount; ++i)
+	{
+		float fraction = (i + 1) / static_cast<float>(cascadeCount);
+		float logSplit = nearPlane * std::pow(shadowDistance / nearPlane, fraction);
+		float linearSplit = nearPlane + (shadowDistance - nearPlane) * fraction;
+
+		auto& cascade = cascades[i];
+		cascade.splitNear = splitNear;
+		cascade.splitFar = splitLogWeight * logSplit + (1.0f - splitLogWeight) * linearSplit;
+		splitNear = cascade.splitFar;
+
+		//The center lies on the view axis, at the depth where it is as far from the near corners as from the far ones.
+		float nearExtent2 = cornerSlope2 * cascade.splitNear * cascade.splitNear;
+		float farExtent2 = cornerSlope2 * cascade.splitFar * cascade.splitFar;
+		float depth = (cascade.splitNear + cascade.splitFar) * 0.5f + (farExtent2 - nearExtent2) / (2.0f * (cascade.splitFar - cascade.splitNear));
+		cascade.centerDepth = std::min(depth, cascade.splitFar);
+
+		float toNear = std::sqrt(nearExtent2 + (cascade.centerDepth - cascade.splitNear) * (cascade.centerDepth - cascade.splitNear));
+		float toFar = std::sqrt(farExtent2 + (cascade.splitFar - cascade.centerDepth) * (cascade.splitFar - cascade.centerDepth));
+		float sliceRadius = std::max(toNear, toFar);
+
+		//The near cascade is refitted every frame and needs no slack.
+		cascade.margin = i == 0 ? 0.0f : sliceRadius * cameraMargin;
+		cascade.radius = sliceRadius + cascade.margin;
+	}
+
+	glGenTextures(1, &depthTexture);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, depthTexture);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, mapSize, mapSize, cascadeCount, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+	//Hardware compare, linear filtering turns every lookup into a 2x2 PCF.
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture, 0, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "Shadow map framebuffer is incomplete." << std::endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	glGenBuffers(1, &uniformBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, uniformBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(ShadowUniforms), nullptr, GL_DYNAMIC_DRAW);
+	glBindBufferBase(GL_UNIFORM_BUFFER, shadowDataBinding, uniformBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void ShadowCascades::update(const WorldInformation& worldInformation)
+{
+	glm::mat4 inverseView = glm::inverse(worldInformation.view);
+	glm::vec3 direction = glm::normalize(worldInformation.lightPosition);
+	float directionThreshold = std::cos(glm::radians(directionThresholdDegrees));
+
+	for (int i = 0; i < cascadeCount; ++i)
+	{
+		auto& cascade = cascades[i];
+		glm::vec3 center = glm::vec3(inverseView * glm::vec4(0.0f, 0.0f, -cascade.centerDepth, 1.0f));
+
+		//Already set when invalidate_region hit it.
+		bool dirty = cascade.dirty || i == 0 || !cascade.valid;
+		dirty |= glm::dot(direction, cascade.lightDirection) < directionThreshold;
+		dirty |= glm::distance(center, cascade.center) > cascade.margin;
+
+		cascade.dirty = dirty;
+		if (dirty)
+			fit(cascade, center, direction);
+	}
+}
+
+void ShadowCascades::fit(Cascade& cascade, const glm::vec3& center, const glm::vec3& direction)
+{
+	//The sun turns around the z axis, so that stays perpendicular to it.
+	glm::vec3 up = std::abs(direction.z) < 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+
+	//Snap the center to whole texels across the light, otherwise the edges crawl while the camera moves.
+	glm::mat4 lightRotation = glm::lookAt(glm::vec3(0.0f), direction, up);
+	glm::vec3 lightCenter = glm::vec3(lightRotation * glm::vec4(center, 1.0f));
+	float texelSize = 2.0f * cascade.radius / mapSize;
+	lightCenter.x = std::floor(lightCenter.x / texelSize) * texelSize;
+	lightCenter.y = std::floor(lightCenter.y / texelSize) * texelSize;
+	glm::vec3 snappedCenter = glm::vec3(glm::inverse(lightRotation) * glm::vec4(lightCenter, 1.0f));
+
+	glm::mat4 lightView = glm::lookAt(snappedCenter - direction * (cascade.radius + casterDistance), snappedCenter, up);
+	glm::mat4 lightProjection = glm::ortho(-cascade.radius, cascade.radius, -cascade.radius, cascade.radius, 0.0f, 2.0f * cascade.radius + casterDistance);
+
+	cascade.center = center;
+	cascade.lightDirection = direction;
+	cascade.lightViewProjection = lightProjection * lightView;
+	cascade.valid = true;
+}
+
+void ShadowCascades::invalidate_region(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+	for (int i = 1; i < cascadeCount; ++i)
+	{
+		if (cascades[i].valid && intersects(i, boundsMin, boundsMax))
+			cascades[i].dirty = true;
+	}
+}
+
+bool ShadowCascades::intersects(int cascade, const glm::vec3& boundsMin, const glm::vec3& boundsMax) const
+{
+	//Orthographic, so the bounds of the projected corners are exact.
+	auto& lightViewProjection = cascades[cascade].lightViewProjection;
+	glm::vec3 clipMin(std::numeric_limits<float>::max());
+	glm::vec3 clipMax(std::numeric_limits<float>::lowest());
+
+	for (int corner = 0; corner < 8; ++corner)
+	{
+		glm::vec3 point((corner & 1) ? boundsMax.x : boundsMin.x, (corner & 2) ? boundsMax.y : boundsMin.y, (corner & 4) ? boundsMax.z : boundsMin.z);
+		glm::vec3 clip = glm::vec3(lightViewProjection * glm::vec4(point, 1.0f));
+		clipMin = glm::min(clipMin, clip);
+		clipMax = glm::max(clipMax, clip);
+	}
+
+	return clipMax.x >= -1.0f && clipMin.x <= 1.0f && clipMax.y >= -1.0f && clipMin.y <= 1.0f && clipMax.z >= -1.0f && clipMin.z <= 1.0f;
+}
+
+void ShadowCascades::begin_cascade(int cascade)
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture, 0, cascade);
+	glViewport(0, 0, mapSize, mapSize);
+	glClear(GL_DEPTH_BUFFER_BIT);
+
+	cascades[cascade].dirty = false;
+	RenderStats::shared_instance().shadowCascadesRendered++;
+}
+
+void ShadowCascades::upload()
+{
+	ShadowUniforms uniforms;
+	for (int i = 0; i < cascadeCount; ++i)
+	{
+		uniforms.lightViewProjection[i] = cascades[i].lightViewProjection;
+		uniforms.cascadeSplits[i] = cascades[i].splitFar;
+		uniforms.cascadeTexelSizes[i] = 2.0f * cascades[i].radius / mapSize;
+	}
+	uniforms.cascadeSplits[3] = 0.0f;
+	uniforms.cascadeTexelSizes[3] = 0.0f;
+
+	glBindBuffer(GL_UNIFORM_BUFFER, uniformBuffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(ShadowUniforms), &uniforms);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	auto& stats = RenderStats::shared_instance();
+	stats.uniformUploads++;
+	stats.frameDataBytes += sizeof(ShadowUniforms);
+}
\ No newline at end of file
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <array>
+
+struct WorldInformation;
+
+//std140 mirror of the ShadowData block in the shaders.
+struct ShadowUniforms
+{
+	glm::mat4 lightViewProjection[3];
+	//View depth where each cascade ends, and the world size of one of its texels.
+	glm::vec4 cascadeSplits;
+	glm::vec4 cascadeTexelSizes;
+};
+
+//Cascaded shadow maps for the sun in one depth texture array. Each cascade covers a bounding sphere around its slice
+//of the view frustum, so its map stays valid while the camera turns. The near cascade is drawn every frame, the far
+//ones are kept until the sun turned past a threshold, a chunk inside them changed or the camera left their margin.
+class ShadowCascades
+{
+public:
+	static constexpr int cascadeCount = 3;
+	//Above the units the meshes bind their material textures to.
+	static constexpr GLuint textureUnit = 7;
+
+	int mapSize = 2048;
+	//Shadows end here, split between the cascades by the practical split scheme with this weight.
+	float shadowDistance = 2000.0f;
+	float splitLogWeight = 0.8f;
+	//Cached cascades are fitted this much larger than their slice, the camera may move that far before they redraw.
+	float cameraMargin = 0.25f;
+	float directionThresholdDegrees = 2.0f;
+	//Distance towards the sun behind the slice that casters are still captured from.
+	float casterDistance = 1000.0f;
+
+	//Only the near plane, field of view and aspect ratio are read from the projection.
+	void initialize(const glm::mat4& projection);
+
+	//Decides which cascades draw this frame and fits those to the camera and sun.
+	void update(const WorldInformation& worldInformation);
+	//A chunk streamed in or out, every cached cascade that can see it has to redraw.
+	void invalidate_region(const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
+	bool needs_render(int cascade) const { return cascades[cascade].dirty; }
+	//Binds the cascade's layer and clears it, the caller then draws the casters with light_view_projection.
+	void begin_cascade(int cascade);
+	const glm::mat4& light_view_projection(int cascade) const { return cascades[cascade].lightViewProjection; }
+	//Box against the cascade's light volume, for culling casters.
+	bool intersects(int cascade, const glm::vec3& boundsMin, const glm::vec3& boundsMax) const;
+
+	//Matrices and splits for the lit shaders, call after the cascades are drawn.
+	void upload();
+	GLuint texture() const { return depthTexture; }
+
+private:
+	struct Cascade
+	{
+		//Slice of the view frustum in view depth and the sphere around it.
+		float splitNear = 0.0f;
+		float splitFar = 0.0f;
+		float centerDepth = 0.0f;
+		float radius = 0.0f;
+		float margin = 0.0f;
+
+		//What the map was last drawn with.
+		glm::vec3 center = glm::vec3(0.0f);
+		glm::vec3 lightDirection = glm::vec3(0.0f);
+		glm::mat4 lightViewProjection = glm::mat4(1.0f);
+		bool valid = false;
+		bool dirty = true;
+	};
+
+	void fit(Cascade& cascade, const glm::vec3& center, const glm::vec3& direction);
+
+	std::array<Cascade, cascadeCount> cascades;
+
+	GLuint depthTexture = 0;
+	GLuint framebuffer = 0;
+	GLuint uniformBuffer = 0;
+};
\ No newline at end of file
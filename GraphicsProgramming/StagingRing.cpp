@@ -0,0 +1,181 @@
+#include "StagingRing.h"
+#include "Profiler.h"
+
+#include <cstring>
+#include <iostream>
+
+static bool has_buffer_storage()
+{
+	GLint major = 0, minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	if (major > 4 || (major == 4 && minor >= 4))
+		return true;
+
+	GLint extensionCount = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+	for (GLint i = 0; i < extensionCount; ++i)
+	{
+		if (std::strcmp(reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i)), "GL_ARB_buffer_storage") == 0)
+			return true;
+	}
+	return false;
+}
+
+bool StagingRing::initialize(GLADloadproc loader, size_t segmentBytes, int segmentCount)
+{
+	startTime = std::chrono::steady_clock::now();
+
+	auto bufferStorage = has_buffer_storage() ? reinterpret_cast<BufferStorageProc>(loader("glBufferStorage")) : nullptr;
+	if (bufferStorage == nullptr)
+	{
+		std::cout << "Persistent mapping not supported, chunks are staged through fresh buffers." << std::endl;
+		return false;
+	}
+
+	segmentSize = segmentBytes;
+	segments = segmentCount;
+	GLsizeiptr size = static_cast<GLsizeiptr>(segmentSize * segments);
+
+	//Coherent, so a write is visible to every command issued after it without a flush. The render thread only issues
+	//the copy after the worker hands the chunk over, which orders the two.
+	GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	glGenBuffers(1, &ringBuffer);
+	glBindBuffer(GL_COPY_READ_BUFFER, ringBuffer);
+	bufferStorage(GL_COPY_READ_BUFFER, size, nullptr, flags);
+	mapped = static_cast<unsigned char*>(glMapBufferRange(GL_COPY_READ_BUFFER, 0, size, flags));
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+	if (mapped == nullptr)
+	{
+		std::cout << "Failed to map the staging ring." << std::endl;
+		glDeleteBuffers(1, &ringBuffer);
+		ringBuffer = 0;
+		segments = 0;
+		return false;
+	}
+
+	//Handed out from the back, so start with segment 0.
+	for (int segment = segments - 1; segment >= 0; --segment)
+		freeSegments.push_back(segment);
+
+	return true;
+}
+
+int StagingRing::acquire()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	if (!enabled())
+		return -1;
+
+	if (freeSegments.empty())
+	{
+		stalls.fetch_add(1, std::memory_order_relaxed);
+		return -1;
+	}
+
+	int segment = freeSegments.back();
+	freeSegments.pop_back();
+	return segment;
+}
+
+bool StagingRing::write(int segment, const void* source, size_t bytes)
+{
+	PROFILE_SCOPE("Staging write");
+
+	//The copy itself runs unlocked, workers write their segments side by side.
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		if (!enabled())
+			return false;
+		writers++;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	std::memcpy(mapped + offset(segment), source, bytes);
+	auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		writers--;
+	}
+	writesDone.notify_all();
+
+	bytesWritten.fetch_add(bytes, std::memory_order_relaxed);
+	writeNanoseconds.fetch_add(static_cast<uint64_t>(elapsed.count()), std::memory_order_relaxed);
+	return true;
+}
+
+void StagingRing::release(int segment)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	freeSegments.push_back(segment);
+}
+
+void StagingRing::fence(int segment)
+{
+	fenced.push_back(FencedSegment{ glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), segment });
+}
+
+void StagingRing::reclaim()
+{
+	while (!fenced.empty())
+	{
+		//A zero timeout only polls.
+		GLenum status = glClientWaitSync(fenced.front().fence, 0, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+			break;
+
+		glDeleteSync(fenced.front().fence);
+		release(fenced.front().segment);
+		fenced.pop_front();
+	}
+}
+
+void StagingRing::shutdown()
+{
+	//Every fence belongs to a copy that is done or will be, nothing reads the ring after this.
+	for (auto& segment : fenced)
+	{
+		glDeleteSync(segment.fence);
+		release(segment.segment);
+	}
+	fenced.clear();
+
+	std::unique_lock<std::mutex> lock(mutex);
+	writesDone.wait(lock, [this] { return writers == 0; });
+
+	if (!enabled())
+		return;
+
+	glBindBuffer(GL_COPY_READ_BUFFER, ringBuffer);
+	glUnmapBuffer(GL_COPY_READ_BUFFER);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glDeleteBuffers(1, &ringBuffer);
+
+	ringBuffer = 0;
+	mapped = nullptr;
+}
+
+void StagingRing::print(std::ostream& stream)
+{
+	//Still printed after shutdown, the counters outlive the buffer.
+	if (segments == 0)
+		return;
+
+	size_t freeCount;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		freeCount = freeSegments.size();
+	}
+
+	double megabytes = bytesWritten.load(std::memory_order_relaxed) / (1024.0 * 1024.0);
+	double writeSeconds = writeNanoseconds.load(std::memory_order_relaxed) * 1e-9;
+	double runSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+	//Write bandwidth is what the workers get into mapped memory, the average spreads it over the whole run.
+	stream << "Staging ring: " << megabytes << " MB streamed, " << (writeSeconds > 0.0 ? megabytes / writeSeconds : 0.0) << " MB/s write, "
+		<< (runSeconds > 0.0 ? megabytes / runSeconds : 0.0) << " MB/s average, " << stalls.load(std::memory_order_relaxed) << " stalls, "
+		<< freeCount << "/" << segments << " segments free" << std::endl;
+}
\ No newline at end of file
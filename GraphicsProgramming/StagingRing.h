@@ -0,0 +1,79 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+//GL 4.4 / ARB_buffer_storage, the loader only knows 3.3 so glBufferStorage is fetched by hand.
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+//One buffer of equal sized segments, persistently and coherently mapped, so a worker can write a chunk straight into
+//GPU visible memory without a context. The render thread copies a segment out with glCopyBufferSubData and fences it,
+//the segment is handed out again once the GPU has passed the fence. Nothing is allocated while streaming.
+class StagingRing
+{
+public:
+	static StagingRing& shared_instance() { static StagingRing ring; return ring; }
+
+	//GL thread. Returns false, and every acquire fails, when the driver can't map buffers persistently.
+	bool initialize(GLADloadproc loader, size_t segmentBytes, int segmentCount);
+	bool enabled() const { return mapped != nullptr; }
+
+	//Any thread. A free segment, or -1 when the GPU still holds every one, which counts as a stall.
+	int acquire();
+	//Any thread. The mapped memory is write combined on most drivers, so it's only written front to back, never read.
+	//False when the ring was shut down after the segment was acquired, nothing is written then.
+	bool write(int segment, const void* source, size_t bytes);
+	//Any thread, for a segment that is given up before anything was copied out of it.
+	void release(int segment);
+
+	GLuint buffer() const { return ringBuffer; }
+	GLintptr offset(int segment) const { return static_cast<GLintptr>(segment * segmentSize); }
+
+	//Render thread, right after the last command that reads the segment.
+	void fence(int segment);
+	//Render thread, once per frame. Frees the segments whose fences have signalled, never waits.
+	void reclaim();
+	//Render thread, before it gives up its context. Waits for writes in progress, then deletes the fences, unmaps and
+	//deletes the buffer. Every acquire fails afterwards.
+	void shutdown();
+
+	void print(std::ostream& stream);
+
+private:
+	struct FencedSegment
+	{
+		GLsync fence;
+		int segment;
+	};
+
+	using BufferStorageProc = void (APIENTRYP)(GLenum, GLsizeiptr, const void*, GLbitfield);
+
+	GLuint ringBuffer = 0;
+	unsigned char* mapped = nullptr;
+	size_t segmentSize = 0;
+	int segments = 0;
+
+	std::mutex mutex;
+	std::condition_variable writesDone;
+	//Guarded by mutex, shutdown waits for it to drop to zero before it unmaps.
+	int writers = 0;
+	std::vector<int> freeSegments;
+	//Render thread only, in the order they were fenced.
+	std::deque<FencedSegment> fenced;
+
+	std::chrono::steady_clock::time_point startTime;
+	std::atomic<uint64_t> bytesWritten = 0;
+	std::atomic<uint64_t> writeNanoseconds = 0;
+	std::atomic<unsigned int> stalls = 0;
+};
\ No newline at end of file
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <utility>
+
+//Lazily started coroutine. Either co_await it from another Task, which resumes the caller once it finishes,
+//or detach it to run fire-and-forget; a detached task frees its own frame when it completes.
+//Where the body runs is decided by what it awaits, e.g. ThreadPool::schedule or ActionQueue::schedule.
+class Task
+{
+public:
+	struct promise_type;
+	using handle_type = std::coroutine_handle<promise_type>;
+
+	struct FinalAwaiter
+	{
+		bool await_ready() const noexcept { return false; }
+		std::coroutine_handle<> await_suspend(handle_type handle) noexcept;
+		void await_resume() const noexcept {}
+	};
+
+	struct promise_type
+	{
+		std::coroutine_handle<> continuation;
+		bool detached = false;
+
+		Task get_return_object() { return Task(handle_type::from_promise(*this)); }
+		std::suspend_always initial_suspend() const noexcept { return {}; }
+		FinalAwaiter final_suspend() const noexcept { return {}; }
+		void return_void() const noexcept {}
+		void unhandled_exception() const noexcept { std::terminate(); }
+	};
+
+	Task() = default;
+	Task(Task&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+	Task& operator=(Task&& other) noexcept;
+	Task(const Task&) = delete;
+	Task& operator=(const Task&) = delete;
+	~Task();
+
+	//Starts the task on the calling thread and gives up ownership of it.
+	void detach();
+
+	bool await_ready() const noexcept { return !handle || handle.done(); }
+	std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept;
+	void await_resume() const noexcept {}
+
+private:
+	explicit Task(handle_type handle) : handle(handle) {}
+
+	handle_type handle;
+};
+
+inline std::coroutine_handle<> Task::FinalAwaiter::await_suspend(handle_type handle) noexcept
+{
+	auto& promise = handle.promise();
+
+	if (promise.detached)
+	{
+		handle.destroy();
+		return std::noop_coroutine();
+	}
+
+	if (promise.continuation)
+		return promise.continuation;
+
+	return std::noop_coroutine();
+}
+
+inline Task& Task::operator=(Task&& other) noexcept
+{
+	if (this != &other)
+	{
+		if (handle)
+			handle.destroy();
+		handle = std::exchange(other.handle, nullptr);
+	}
+	return *this;
+}
+
+inline Task::~Task()
+{
+	if (handle)
+		handle.destroy();
+}
+
+inline void Task::detach()
+{
+	if (!handle)
+		return;
+
+	auto started = std::exchange(handle, nullptr);
+	started.promise().detached = true;
+	started.resume();
+}
+
+inline std::coroutine_handle<> Task::await_suspend(std::coroutine_handle<> awaiting) noexcept
+{
+	//Symmetric transfer, the awaiting coroutine is resumed from the final suspend point of this task.
+	handle.promise().continuation = awaiting;
+	return handle;
+}
\ No newline at end of file
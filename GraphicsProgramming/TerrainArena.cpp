@@ -0,0 +1,156 @@
+#include "TerrainArena.h"
+#include "RenderStats.h"
+
+void TerrainArena::initialize(int gridSize, int initialSlots)
+{
+	slotVertices = gridSize * gridSize;
+	slotBytes = static_cast<GLsizeiptr>(slotVertices) * stride * sizeof(float);
+	slotCapacity = initialSlots;
+
+	std::vector<unsigned int> indices;
+	indices.reserve((gridSize - 1) * (gridSize - 1) * 6);
+
+	for (int i = 0; i < (gridSize - 1) * (gridSize - 1); ++i)
+	{
+		int x = i % (gridSize - 1);
+		int z = i / (gridSize - 1);
+
+		unsigned int vertex = z * gridSize + x;
+
+		indices.push_back(vertex);
+		indices.push_back(vertex + gridSize);
+		indices.push_back(vertex + gridSize + 1);
+		indices.push_back(vertex);
+		indices.push_back(vertex + gridSize + 1);
+		indices.push_back(vertex + 1);
+	}
+	indexCount = static_cast<GLsizei>(indices.size());
+
+	glGenVertexArrays(1, &vertexArray);
+	glGenBuffers(1, &vertexBuffer);
+	glGenBuffers(1, &indexBuffer);
+
+	glBindVertexArray(vertexArray);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, slotBytes * slotCapacity, nullptr, GL_STATIC_DRAW);
+	setup_vertex_array();
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void TerrainArena::setup_vertex_array()
+{
+	//Expects the vertex array and the vertex buffer to be bound.
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(float) * stride, 0);
+	glEnableVertexAttribArray(0);
+
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(float) * stride, (void*)(sizeof(float) * 3));
+	glEnableVertexAttribArray(1);
+
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(float) * stride, (void*)(sizeof(float) * 6));
+	glEnableVertexAttribArray(2);
+
+	glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(float) * stride, (void*)(sizeof(float) * 8));
+	glEnableVertexAttribArray(3);
+}
+
+void TerrainArena::grow()
+{
+	//Copy on the GPU into a buffer twice the size, the old contents never come back to the CPU.
+	GLuint newBuffer;
+	glGenBuffers(1, &newBuffer);
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, slotBytes * slotCapacity * 2, nullptr, GL_STATIC_DRAW);
+
+	glBindBuffer(GL_COPY_READ_BUFFER, vertexBuffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, slotBytes * slotCapacity);
+
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	glDeleteBuffers(1, &vertexBuffer);
+
+	vertexBuffer = newBuffer;
+	slotCapacity *= 2;
+
+	//The attribute pointers captured the old buffer.
+	glBindVertexArray(vertexArray);
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+	setup_vertex_array();
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+int TerrainArena::acquire_slot()
+{
+	if (!freeSlots.empty())
+	{
+		int slot = freeSlots.back();
+		freeSlots.pop_back();
+		return slot;
+	}
+
+	if (nextSlot == slotCapacity)
+		grow();
+	return nextSlot++;
+}
+
+int TerrainArena::allocate(const std::vector<float>& vertices)
+{
+	int slot = acquire_slot();
+
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+	glBufferSubData(GL_ARRAY_BUFFER, slotBytes * slot, slotBytes, vertices.data());
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	auto& stats = RenderStats::shared_instance();
+	stats.chunksUploaded++;
+	stats.bytesUploaded += static_cast<unsigned int>(slotBytes);
+
+	return slot;
+}
+
+int TerrainArena::allocate(GLuint sourceBuffer, GLintptr sourceOffset)
+{
+	int slot = acquire_slot();
+
+	glBindBuffer(GL_COPY_READ_BUFFER, sourceBuffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, vertexBuffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, sourceOffset, slotBytes * slot, slotBytes);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	auto& stats = RenderStats::shared_instance();
+	stats.chunksUploaded++;
+	stats.bytesUploaded += static_cast<unsigned int>(slotBytes);
+
+	return slot;
+}
+
+GLuint TerrainArena::create_staging(const std::vector<float>& vertices)
+{
+	//Filled once and only ever copied from, the copy in allocate reads it on the GPU.
+	GLuint buffer;
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	return buffer;
+}
+
+void TerrainArena::release(int slot)
+{
+	freeSlots.push_back(slot);
+}
+
+void TerrainArena::add_draw(MultiDraw& list, int slot) const
+{
+	list.counts.push_back(indexCount);
+	list.offsets.push_back(nullptr);
+	list.baseVertices.push_back(slot * slotVertices);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <cstddef>
+#include <vector>
+
+//Argument lists for one glMultiDrawElementsBaseVertex call.
+struct MultiDraw
+{
+	std::vector<GLsizei> counts;
+	std::vector<const void*> offsets;
+	std::vector<GLint> baseVertices;
+
+	void clear() { counts.clear(); offsets.clear(); baseVertices.clear(); }
+	GLsizei size() const { return static_cast<GLsizei>(counts.size()); }
+};
+
+//Every resident terrain chunk lives in one vertex buffer, one fixed size slot per chunk, sharing a single index buffer
+//and vertex array. All chunks are the same grid, so the index list is built once and each chunk only differs in
+//its base vertex. GL 3.3 has no gl_DrawID to fetch a per chunk transform with, so chunk vertices are in world space.
+class TerrainArena
+{
+public:
+	//Stride in floats, position, normal, uv and the splat weights packed as four bytes in the last slot.
+	static constexpr int stride = 9;
+
+	void initialize(int gridSize, int initialSlots = 32);
+
+	//Copies the chunk into a free slot, grows the buffer when full. Returns the slot.
+	int allocate(const std::vector<float>& vertices);
+	//Same, from a buffer made by create_staging or a StagingRing segment. The copy stays on the GPU, the source can be
+	//deleted or fenced right after.
+	int allocate(GLuint sourceBuffer, GLintptr sourceOffset = 0);
+
+	//Any thread with a context shared with the arena's, see UploadQueue. A buffer holding one chunk's vertices.
+	static GLuint create_staging(const std::vector<float>& vertices);
+	void release(int slot);
+
+	//Per frame draw list, chunks should be added front to back.
+	void clear_draws() { draws.clear(); }
+	void add_draw(int slot) { add_draw(draws, slot); }
+	const MultiDraw& draw_list() const { return draws; }
+
+	//Appends a slot to a draw list of the caller's, e.g. one per shadow cascade.
+	void add_draw(MultiDraw& list, int slot) const;
+
+	GLuint vao() const { return vertexArray; }
+	size_t resident_count() const { return static_cast<size_t>(nextSlot) - freeSlots.size(); }
+	size_t capacity() const { return static_cast<size_t>(slotCapacity); }
+	size_t slot_bytes() const { return static_cast<size_t>(slotBytes); }
+
+private:
+	void grow();
+	void setup_vertex_array();
+	int acquire_slot();
+
+	GLuint vertexArray = 0;
+	GLuint vertexBuffer = 0;
+	GLuint indexBuffer = 0;
+
+	GLsizei indexCount = 0;
+	GLsizeiptr slotBytes = 0;
+	int slotVertices = 0;
+	int slotCapacity = 0;
+	int nextSlot = 0;
+	std::vector<int> freeSlots;
+
+	MultiDraw draws;
+};
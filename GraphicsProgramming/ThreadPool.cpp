@@ -1 +1,231 @@
 #include "ThreadPool.h"
+#include "Profiler.h"
+
+#include <fstream>
+
+static const char* laneNames[] = { "FrameCritical", "Streaming", "Background", "IO" };
+
+ThreadPool::ThreadPool(size_t numThreads, size_t numIoThreads)
+	: workerCounters(std::make_unique<WorkerCounters[]>(numThreads + numIoThreads)), workerCount(numThreads + numIoThreads), stop(false)
+{
+	if (numThreads < 1)
+		throw std::invalid_argument("Number of threads must be at least 1");
+
+	//Streaming and background work give way to the classes above them, but not forever.
+	lanes[static_cast<size_t>(TaskPriority::Streaming)].agingThreshold = std::chrono::milliseconds(50);
+	lanes[static_cast<size_t>(TaskPriority::Background)].agingThreshold = std::chrono::milliseconds(200);
+
+	threads.reserve(numThreads);
+	for (size_t i = 0; i < numThreads; ++i)
+	{
+		threads.emplace_back([this, i] { worker_loop(workerCounters[i], false); });
+	}
+
+	ioThreads.reserve(numIoThreads);
+	for (size_t i = 0; i < numIoThreads; ++i)
+	{
+		workerCounters[numThreads + i].io = true;
+		ioThreads.emplace_back([this, i, numThreads] { worker_loop(workerCounters[numThreads + i], true); });
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	shutdown();
+}
+
+void ThreadPool::shutdown()
+{
+	{
+		std::unique_lock<std::mutex> lock(queue_mutex);
+		stop.store(true);
+	}
+	condition.notify_all();
+	ioCondition.notify_all();
+
+	for (std::thread& thread : threads)
+	{
+		if (thread.joinable())
+			thread.join();
+	}
+
+	for (std::thread& thread : ioThreads)
+	{
+		if (thread.joinable())
+			thread.join();
+	}
+}
+
+size_t ThreadPool::select_lane(bool io, Clock::time_point now) const
+{
+	if (io)
+		return lanes[ioLane].tasks.empty() ? noLane : ioLane;
+
+	//Promote the lowest class that has waited past its threshold, so a steady stream of urgent work can't starve it.
+	for (size_t lane = computeLanes - 1; lane > 0; --lane)
+	{
+		auto& tasks = lanes[lane].tasks;
+		if (!tasks.empty() && now - tasks.front().enqueueTime >= lanes[lane].agingThreshold)
+			return lane;
+	}
+
+	for (size_t lane = 0; lane < computeLanes; ++lane)
+	{
+		if (!lanes[lane].tasks.empty())
+			return lane;
+	}
+
+	return noLane;
+}
+
+void ThreadPool::worker_loop(WorkerCounters& counters, bool io)
+{
+	auto& wakeUp = io ? ioCondition : condition;
+#if THREADPOOL_STATS
+	auto idleSince = Clock::now();
+#endif
+	PROFILE_THREAD_NAME(io ? "IO worker" : "Worker");
+
+	while (true)
+	{
+		QueuedTask task;
+		size_t lane = noLane;
+
+		{
+			std::unique_lock<std::mutex> lock(queue_mutex);
+			wakeUp.wait(lock, [&] { lane = select_lane(io, Clock::now()); return stop.load() || lane != noLane; });
+
+			if (lane == noLane)
+				return;
+
+			task = std::move(lanes[lane].tasks.front());
+			lanes[lane].tasks.pop();
+		}
+
+		//No other thread writes these, so plain loads and stores do instead of read-modify-writes.
+		auto& stats = counters.lanes[lane];
+		auto startTime = Clock::now();
+		int64_t waitNs = std::chrono::duration_cast<std::chrono::nanoseconds>(startTime - task.enqueueTime).count();
+		stats.totalWaitNs.store(stats.totalWaitNs.load(std::memory_order_relaxed) + waitNs, std::memory_order_relaxed);
+		if (waitNs > stats.maxWaitNs.load(std::memory_order_relaxed))
+			stats.maxWaitNs.store(waitNs, std::memory_order_relaxed);
+
+		task.func();
+		stats.completed.store(stats.completed.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+#if THREADPOOL_STATS
+		auto endTime = Clock::now();
+		int64_t runNs = std::chrono::duration_cast<std::chrono::nanoseconds>(endTime - startTime).count();
+
+		counters.waitHistograms[lane].record(waitNs);
+		counters.runHistograms[lane].record(runNs);
+
+		counters.tasks.store(counters.tasks.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		counters.busyNs.store(counters.busyNs.load(std::memory_order_relaxed) + runNs, std::memory_order_relaxed);
+		counters.idleNs.store(counters.idleNs.load(std::memory_order_relaxed) + std::chrono::duration_cast<std::chrono::nanoseconds>(startTime - idleSince).count(), std::memory_order_relaxed);
+		idleSince = endTime;
+#endif
+	}
+}
+
+QueueStats ThreadPool::get_lane_stats(size_t lane) const
+{
+	QueueStats stats;
+
+	{
+		std::unique_lock<std::mutex> lock(queue_mutex);
+		stats.depth = lanes[lane].tasks.size();
+	}
+
+	int64_t totalWaitNs = 0;
+	int64_t maxWaitNs = 0;
+	for (size_t i = 0; i < workerCount; ++i)
+	{
+		auto& counters = workerCounters[i].lanes[lane];
+		stats.completed += counters.completed.load(std::memory_order_relaxed);
+		totalWaitNs += counters.totalWaitNs.load(std::memory_order_relaxed);
+		maxWaitNs = std::max(maxWaitNs, counters.maxWaitNs.load(std::memory_order_relaxed));
+	}
+
+	stats.maxWaitMs = maxWaitNs / 1e6;
+	if (stats.completed > 0)
+		stats.averageWaitMs = totalWaitNs / 1e6 / stats.completed;
+
+	return stats;
+}
+
+QueueStats ThreadPool::get_queue_stats(TaskPriority priority) const
+{
+	return get_lane_stats(static_cast<size_t>(priority));
+}
+
+QueueStats ThreadPool::get_io_queue_stats() const
+{
+	return get_lane_stats(ioLane);
+}
+
+void ThreadPool::print_queue_stats(std::ostream& stream) const
+{
+	for (size_t lane = 0; lane <= ioLane; ++lane)
+	{
+		auto stats = get_lane_stats(lane);
+		stream << laneNames[lane] << ": depth " << stats.depth << ", completed " << stats.completed
+			<< ", avg wait " << stats.averageWaitMs << " ms, max wait " << stats.maxWaitMs << " ms" << std::endl;
+	}
+}
+
+ThreadPoolSnapshot ThreadPool::snapshot() const
+{
+	ThreadPoolSnapshot result;
+	result.lanes.resize(lanes.size());
+
+	{
+		std::unique_lock<std::mutex> lock(queue_mutex);
+		for (size_t lane = 0; lane < lanes.size(); ++lane)
+		{
+			result.lanes[lane].depth = lanes[lane].tasks.size();
+			result.lanes[lane].highWaterMark = lanes[lane].highWaterMark;
+		}
+	}
+
+	for (size_t lane = 0; lane < lanes.size(); ++lane)
+	{
+		auto& snapshot = result.lanes[lane];
+		snapshot.name = laneNames[lane];
+		for (size_t i = 0; i < workerCount; ++i)
+		{
+			snapshot.completed += workerCounters[i].lanes[lane].completed.load(std::memory_order_relaxed);
+#if THREADPOOL_STATS
+			snapshot.wait.add(workerCounters[i].waitHistograms[lane].snapshot());
+			snapshot.run.add(workerCounters[i].runHistograms[lane].snapshot());
+#endif
+		}
+	}
+
+#if THREADPOOL_STATS
+	result.workers.resize(workerCount);
+	for (size_t i = 0; i < workerCount; ++i)
+	{
+		auto& counters = workerCounters[i];
+		result.workers[i].io = counters.io;
+		result.workers[i].tasks = counters.tasks.load(std::memory_order_relaxed);
+		result.workers[i].busyMs = counters.busyNs.load(std::memory_order_relaxed) / 1e6;
+		result.workers[i].idleMs = counters.idleNs.load(std::memory_order_relaxed) / 1e6;
+	}
+#endif
+
+	return result;
+}
+
+void ThreadPool::write_stats_json(const char* filePath) const
+{
+	std::ofstream file(filePath);
+
+	if (!file.is_open())
+	{
+		std::cout << "Failed to write thread pool stats to " << filePath << std::endl;
+		return;
+	}
+
+	snapshot().write_json(file);
+}
\ No newline at end of file
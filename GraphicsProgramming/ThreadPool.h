@@ -4,71 +4,163 @@
 #include <queue>
 #include <functional>
 #include <iostream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <array>
+#include <algorithm>
+#include <condition_variable>
+#include <coroutine>
+#include <memory>
+#include "CancellationToken.h"
+#include "ThreadPoolStats.h"
+
+//Lower value is picked first. Tasks that wait longer than their class's aging threshold are picked before anything else.
+enum class TaskPriority
+{
+	FrameCritical = 0,
+	Streaming,
+	Background,
+	Count
+};
+
+struct QueueStats
+{
+	size_t depth = 0;
+	uint64_t completed = 0;
+	double averageWaitMs = 0.0;
+	double maxWaitMs = 0.0;
+};
 
 class ThreadPool
 {
 public:
+	using Clock = std::chrono::steady_clock;
 
-	ThreadPool(size_t numThreads) : stop(false), threads(numThreads)
-	{
-		if (numThreads < 1)
-			throw std::invalid_argument("Number of threads must be at least 1");
-
-		threads.reserve(numThreads);
-
-		for (unsigned int i = 0; i < numThreads; ++i)
-		{
-			threads.emplace_back([this]
-				{
-					while (true)
-					{
-						std::function<void()> task;
-
-						{
-							std::unique_lock<std::mutex> lock(queue_mutex);
-							condition.wait(lock, [this] { return stop.load() || !tasks.empty(); });
-
-							if (stop.load() && tasks.empty())
-								return;
-
-							task = std::move(tasks.front());
-							tasks.pop();
-						}
-						task();
-					}
-				});
-		}
-	}
+	ThreadPool(size_t numThreads, size_t numIoThreads = 1);
+	~ThreadPool();
+
+	static ThreadPool& shared_instance() { static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency())); return pool; }
 
 	template<typename F>
-	void enqueue(F&& task);
+	void enqueue(F&& task, TaskPriority priority = TaskPriority::Background);
 
-	~ThreadPool()
+	//Blocking file I/O goes here, it runs on its own threads so disk waits never occupy a compute worker.
+	template<typename F>
+	void enqueue_io(F&& task);
+
+	//Finishes all queued work and joins the workers, safe to call more than once.
+	void shutdown();
+
+	QueueStats get_queue_stats(TaskPriority priority) const;
+	QueueStats get_io_queue_stats() const;
+	void print_queue_stats(std::ostream& stream) const;
+
+	//Cheap copy of all counters, safe to call from any thread while the pool is running.
+	ThreadPoolSnapshot snapshot() const;
+	void write_stats_json(const char* filePath) const;
+
+	//co_await threadPool.schedule() continues the coroutine on a worker thread.
+	//Resolves to false, without hopping, once the token has been cancelled.
+	struct ScheduleAwaiter
 	{
-		stop.store(true);
-		condition.notify_all();
-
-		for (std::thread& thread : threads)
-		{
-			if (thread.joinable())
-				thread.join();
-		}
-	}
+		ThreadPool& pool;
+		CancellationToken token;
+		size_t lane;
+
+		bool await_ready() const noexcept { return token.is_cancelled(); }
+		void await_suspend(std::coroutine_handle<> handle) { pool.push(lane, [handle] { handle.resume(); }); }
+		bool await_resume() const noexcept { return !token.is_cancelled(); }
+	};
+
+	ScheduleAwaiter schedule(CancellationToken token = {}, TaskPriority priority = TaskPriority::Background) { return ScheduleAwaiter{ *this, std::move(token), static_cast<size_t>(priority) }; }
+	ScheduleAwaiter schedule_io(CancellationToken token = {}) { return ScheduleAwaiter{ *this, std::move(token), ioLane }; }
 
 private:
+	static constexpr size_t computeLanes = static_cast<size_t>(TaskPriority::Count);
+	static constexpr size_t ioLane = computeLanes;
+	static constexpr size_t noLane = ~size_t(0);
+
+	struct QueuedTask
+	{
+		std::function<void()> func;
+		Clock::time_point enqueueTime;
+	};
+
+	struct Lane
+	{
+		std::queue<QueuedTask> tasks;
+		Clock::duration agingThreshold = Clock::duration::max();
+
+		//Guarded by queue_mutex.
+		size_t highWaterMark = 0;
+	};
+
+	//What one worker has taken from a lane. Atomic only so stats can be read while the pool runs.
+	struct LaneCounters
+	{
+		std::atomic<uint64_t> completed = 0;
+		std::atomic<int64_t> totalWaitNs = 0;
+		std::atomic<int64_t> maxWaitNs = 0;
+	};
+
+	//Only written by its own worker, on its own cache lines so workers don't slow each other down. The lane
+	//counters and histograms are summed over all workers when stats are read.
+	struct alignas(64) WorkerCounters
+	{
+		bool io = false;
+		std::array<LaneCounters, computeLanes + 1> lanes;
+#if THREADPOOL_STATS
+		std::atomic<uint64_t> tasks = 0;
+		std::atomic<int64_t> busyNs = 0;
+		std::atomic<int64_t> idleNs = 0;
+		std::array<LatencyHistogram, computeLanes + 1> waitHistograms;
+		std::array<LatencyHistogram, computeLanes + 1> runHistograms;
+#endif
+	};
+
+	template<typename F>
+	void push(size_t lane, F&& task);
+
+	void worker_loop(WorkerCounters& counters, bool io);
+	size_t select_lane(bool io, Clock::time_point now) const;
+	QueueStats get_lane_stats(size_t lane) const;
+
 	std::vector<std::thread> threads;
-	std::mutex queue_mutex;
-	std::queue<std::function<void()>> tasks;
+	std::vector<std::thread> ioThreads;
+	std::unique_ptr<WorkerCounters[]> workerCounters;
+	size_t workerCount;
+	mutable std::mutex queue_mutex;
+	std::array<Lane, computeLanes + 1> lanes;
 	std::condition_variable condition;
+	std::condition_variable ioCondition;
 	std::atomic_bool stop;
 };
 
 template<typename F>
-inline void ThreadPool::enqueue(F&& task)
+inline void ThreadPool::enqueue(F&& task, TaskPriority priority)
+{
+	push(static_cast<size_t>(priority), std::forward<F>(task));
+}
+
+template<typename F>
+inline void ThreadPool::enqueue_io(F&& task)
+{
+	push(ioLane, std::forward<F>(task));
+}
+
+template<typename F>
+inline void ThreadPool::push(size_t lane, F&& task)
 {
 	{
 		std::unique_lock<std::mutex> lock(queue_mutex);
-		tasks.emplace(std::forward<F>(task));
+		auto& tasks = lanes[lane].tasks;
+		tasks.push(QueuedTask{ std::function<void()>(std::forward<F>(task)), Clock::now() });
+		lanes[lane].highWaterMark = std::max(lanes[lane].highWaterMark, tasks.size());
 	}
-	condition.notify_one();
+
+	if (lane == ioLane)
+		ioCondition.notify_one();
+	else
+		condition.notify_one();
 }
\ No newline at end of file
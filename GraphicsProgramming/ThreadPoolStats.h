@@ -0,0 +1,147 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+//Set to 0 to compile the histograms and per worker timers out of ThreadPool.
+#ifndef THREADPOOL_STATS
+#define THREADPOOL_STATS 1
+#endif
+
+//Bucket i counts samples in [2^(i-1), 2^i) nanoseconds, the last bucket also takes everything above ~1 s.
+constexpr size_t histogramBuckets = 31;
+
+struct HistogramSnapshot
+{
+	std::array<uint64_t, histogramBuckets> buckets{};
+	uint64_t count = 0;
+
+	//Upper bound of the bucket containing the percentile, in milliseconds.
+	double percentile_ms(double percentile) const;
+	void add(const HistogramSnapshot& other);
+};
+
+//One writer, any number of readers. Every ThreadPool worker records into its own.
+class LatencyHistogram
+{
+public:
+	void record(int64_t nanoseconds);
+	HistogramSnapshot snapshot() const;
+
+private:
+	std::array<std::atomic<uint64_t>, histogramBuckets> buckets{};
+};
+
+struct WorkerSnapshot
+{
+	bool io = false;
+	uint64_t tasks = 0;
+	double busyMs = 0.0;
+	double idleMs = 0.0;
+};
+
+struct LaneSnapshot
+{
+	const char* name = "";
+	size_t depth = 0;
+	size_t highWaterMark = 0;
+	uint64_t completed = 0;
+	HistogramSnapshot wait;
+	HistogramSnapshot run;
+};
+
+struct ThreadPoolSnapshot
+{
+	std::vector<LaneSnapshot> lanes;
+	std::vector<WorkerSnapshot> workers;
+
+	void write_json(std::ostream& stream) const;
+};
+
+inline void LatencyHistogram::record(int64_t nanoseconds)
+{
+	size_t bucket = nanoseconds <= 0 ? 0 : std::bit_width(static_cast<uint64_t>(nanoseconds));
+	if (bucket >= histogramBuckets)
+		bucket = histogramBuckets - 1;
+
+	buckets[bucket].store(buckets[bucket].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+inline HistogramSnapshot LatencyHistogram::snapshot() const
+{
+	HistogramSnapshot result;
+	for (size_t i = 0; i < histogramBuckets; ++i)
+	{
+		result.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+		result.count += result.buckets[i];
+	}
+	return result;
+}
+
+inline void HistogramSnapshot::add(const HistogramSnapshot& other)
+{
+	for (size_t i = 0; i < histogramBuckets; ++i)
+		buckets[i] += other.buckets[i];
+	count += other.count;
+}
+
+inline double HistogramSnapshot::percentile_ms(double percentile) const
+{
+	if (count == 0)
+		return 0.0;
+
+	uint64_t target = static_cast<uint64_t>(percentile * (count - 1)) + 1;
+	uint64_t seen = 0;
+
+	for (size_t i = 0; i < histogramBuckets; ++i)
+	{
+		seen += buckets[i];
+		if (seen >= target)
+			return static_cast<double>(uint64_t(1) << i) / 1e6;
+	}
+	return static_cast<double>(uint64_t(1) << (histogramBuckets - 1)) / 1e6;
+}
+
+inline void write_histogram_json(std::ostream& stream, const HistogramSnapshot& histogram)
+{
+	stream << "{ \"count\": " << histogram.count
+		<< ", \"p50Ms\": " << histogram.percentile_ms(0.5)
+		<< ", \"p95Ms\": " << histogram.percentile_ms(0.95)
+		<< ", \"p99Ms\": " << histogram.percentile_ms(0.99)
+		<< ", \"bucketsLog2Ns\": [";
+
+	for (size_t i = 0; i < histogramBuckets; ++i)
+		stream << (i == 0 ? "" : ", ") << histogram.buckets[i];
+
+	stream << "] }";
+}
+
+inline void ThreadPoolSnapshot::write_json(std::ostream& stream) const
+{
+	stream << "{\n  \"lanes\": [\n";
+	for (size_t i = 0; i < lanes.size(); ++i)
+	{
+		auto& lane = lanes[i];
+		stream << "    { \"name\": \"" << lane.name << "\", \"depth\": " << lane.depth
+			<< ", \"highWaterMark\": " << lane.highWaterMark << ", \"completed\": " << lane.completed
+			<< ",\n      \"wait\": ";
+		write_histogram_json(stream, lane.wait);
+		stream << ",\n      \"run\": ";
+		write_histogram_json(stream, lane.run);
+		stream << " }" << (i + 1 < lanes.size() ? "," : "") << "\n";
+	}
+
+	stream << "  ],\n  \"workers\": [\n";
+	for (size_t i = 0; i < workers.size(); ++i)
+	{
+		auto& worker = workers[i];
+		stream << "    { \"io\": " << (worker.io ? "true" : "false") << ", \"tasks\": " << worker.tasks
+			<< ", \"busyMs\": " << worker.busyMs << ", \"idleMs\": " << worker.idleMs << " }"
+			<< (i + 1 < workers.size() ? "," : "") << "\n";
+	}
+	stream << "  ]\n}\n";
+}
\ No newline at end of file
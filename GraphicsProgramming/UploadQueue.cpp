@@ -0,0 +1,135 @@
+#include "UploadQueue.h"
+#include "ActionQueue.h"
+#include "Profiler.h"
+
+#include <GLFW/glfw3.h>
+#include <vector>
+
+void UploadQueue::start(GLFWwindow* context)
+{
+	started = true;
+	thread = std::thread([this, context] { upload_loop(context); });
+}
+
+void UploadQueue::shutdown()
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		stop = true;
+	}
+	condition.notify_all();
+
+	//The upload that is running finishes up to its next suspension, which parks it in one of the queues.
+	if (thread.joinable())
+		thread.join();
+
+	std::queue<std::coroutine_handle<>> dropped;
+	std::deque<FencedUpload> droppedFenced;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		dropped.swap(uploads);
+		droppedFenced.swap(fenced);
+	}
+
+	//Unlocked, destroying a frame runs its destructors.
+	for (; !dropped.empty(); dropped.pop())
+		dropped.front().destroy();
+
+	for (auto& upload : droppedFenced)
+	{
+		glDeleteSync(upload.fence);
+		upload.handle.destroy();
+	}
+}
+
+void UploadQueue::upload_loop(GLFWwindow* context)
+{
+	PROFILE_THREAD_NAME("Upload");
+	glfwMakeContextCurrent(context);
+
+	while (true)
+	{
+		std::coroutine_handle<> upload;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			condition.wait(lock, [this] { return stop || !uploads.empty(); });
+			if (stop)
+				break;
+
+			upload = uploads.front();
+			uploads.pop();
+		}
+
+		PROFILE_SCOPE("Upload");
+		upload.resume();
+	}
+
+	glfwMakeContextCurrent(nullptr);
+}
+
+void UploadQueue::ScheduleAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+	if (!queue.started)
+	{
+		ActionQueue::shared_instance().AddActionToQueue([handle] { handle.resume(); });
+		return;
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(queue.mutex);
+		if (!queue.stop)
+		{
+			queue.uploads.push(handle);
+			lock.unlock();
+			queue.condition.notify_one();
+			return;
+		}
+	}
+
+	//Shut down, nothing would ever resume it.
+	handle.destroy();
+}
+
+void UploadQueue::CompletionAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+	//The fence only signals once the commands before it reach the GPU, flush so the render thread isn't waiting on this
+	//context's next batch.
+	GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glFlush();
+
+	std::unique_lock<std::mutex> lock(queue.mutex);
+	queue.fenced.push_back(FencedUpload{ fence, handle });
+}
+
+size_t UploadQueue::collect()
+{
+	PROFILE_SCOPE("Collect uploads");
+
+	std::vector<std::coroutine_handle<>> finished;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		while (!fenced.empty())
+		{
+			//A zero timeout only polls.
+			GLenum status = glClientWaitSync(fenced.front().fence, 0, 0);
+			if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+				break;
+
+			glDeleteSync(fenced.front().fence);
+			finished.push_back(fenced.front().handle);
+			fenced.pop_front();
+		}
+	}
+
+	//Unlocked, a resumed upload may schedule the next one.
+	for (auto handle : finished)
+		handle.resume();
+
+	return finished.size();
+}
+
+size_t UploadQueue::pending_count()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	return uploads.size() + fenced.size();
+}
\ No newline at end of file
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include "CancellationToken.h"
+
+struct GLFWwindow;
+
+//Thread with its own GL context, shared with the render thread's, that buffer and texture uploads run on so they
+//never stall a frame. An upload coroutine hops onto it with schedule, creates and fills its objects, then awaits
+//completion: that fences the upload and resumes the coroutine on the render thread once the GPU has finished it.
+//Vertex arrays and framebuffers are not shared between contexts, those are made after the hop back.
+class UploadQueue
+{
+public:
+	static UploadQueue& shared_instance() { static UploadQueue queue; return queue; }
+
+	//Starts the thread on the window's context, which has to share objects with the render thread's.
+	//Without a call uploads run on the render thread through the ActionQueue.
+	void start(GLFWwindow* context);
+	//Render thread, before it gives up its context. Joins the upload thread, then destroys every upload still queued
+	//or waiting on its fence and deletes the fences. Uploads scheduled afterwards are destroyed right away, so only
+	//detached tasks, which nothing else resumes, may await the queue. Safe to call more than once.
+	void shutdown();
+
+	//Render thread, once per frame. Resumes every upload whose fence has signalled, in the order they were fenced.
+	//Never waits on the GPU, an unfinished upload and everything fenced after it are left for the next frame.
+	size_t collect();
+
+	size_t pending_count();
+
+	//co_await uploadQueue.schedule() continues the coroutine on the upload thread.
+	//Resolves to false, without hopping, once the token has been cancelled.
+	struct ScheduleAwaiter
+	{
+		UploadQueue& queue;
+		CancellationToken token;
+
+		bool await_ready() const noexcept { return token.is_cancelled(); }
+		void await_suspend(std::coroutine_handle<> handle);
+		bool await_resume() const noexcept { return !token.is_cancelled(); }
+	};
+
+	//co_await uploadQueue.completion() on the upload thread continues on the render thread once the GPU has executed
+	//everything the coroutine issued so far. Resolves to false, still on the upload thread, once the token has been cancelled.
+	struct CompletionAwaiter
+	{
+		UploadQueue& queue;
+		CancellationToken token;
+
+		//Uploads that ran on the render thread are already in its command stream.
+		bool await_ready() const noexcept { return token.is_cancelled() || !queue.started; }
+		void await_suspend(std::coroutine_handle<> handle);
+		bool await_resume() const noexcept { return !token.is_cancelled(); }
+	};
+
+	ScheduleAwaiter schedule(CancellationToken token = {}) { return ScheduleAwaiter{ *this, std::move(token) }; }
+	CompletionAwaiter completion(CancellationToken token = {}) { return CompletionAwaiter{ *this, std::move(token) }; }
+
+private:
+	struct FencedUpload
+	{
+		GLsync fence;
+		std::coroutine_handle<> handle;
+	};
+
+	void upload_loop(GLFWwindow* context);
+
+	std::thread thread;
+	//Set once by start and never cleared, an upload the thread is finishing during shutdown still fences normally.
+	std::atomic_bool started = false;
+	//Guarded by mutex.
+	bool stop = false;
+
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::queue<std::coroutine_handle<>> uploads;
+	std::deque<FencedUpload> fenced;
+};
\ No newline at end of file
@@ -9,9 +9,27 @@
 #include "ThreadPool.h"
 #include "perlin_noise.hpp"
 #include "ActionQueue.h"
+#include "Parallel.h"
+#include "Task.h"
+#include "ChunkBufferPool.h"
+#include "ModelRegistry.h"
+#include "Profiler.h"
+#include "FrameStats.h"
+#include "CameraPath.h"
+#include "RenderTarget.h"
+#include "DynamicResolution.h"
+#include "FramePacket.h"
+#include "UploadQueue.h"
+#include "StagingRing.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <utility>
 
 struct Entity
 {
+	//Owned by the ModelRegistry, entities with the same asset share it.
 	Model* model;
 	glm::vec3 position;
 	glm::vec3 rotation;
@@ -25,7 +43,7 @@ void process_input(GLFWwindow*& window);
 
 void initialize_world_information(WorldInformation& worldInformation);
 
-void generate_landscape_chunk(const glm::vec2 currentChunkCord, const glm::vec3 position, const int size, float hScale, float xzScale, glm::vec3 offset, int concurrencyLevel = -1);
+Task generate_landscape_chunk(const glm::vec2 currentChunkCord, const glm::vec3 position, const int size, float hScale, float xzScale, glm::vec3 offset, CancellationToken token, TaskPriority priority, int concurrencyLevel = -1);
 
 void create_shaders(Renderer& renderer);
 
@@ -35,13 +53,46 @@ void key_call_back(GLFWwindow* window, int key, int scancode, int action, int mo
 
 void check_visible_planes();
 void load_textures();
+Task upload_textures();
 
 void load_models(std::vector<Entity>& entities);
 
+void write_frame_report();
+
+void render_thread(GLFWwindow* window, RenderTarget& offscreenTarget, std::chrono::steady_clock::time_point launchTime, std::chrono::steady_clock::duration shaderTime);
+void receive_uploaded_chunks();
+
+bool parse_arguments(int argc, char** argv);
+void set_camera(const CameraSample& sample);
+
 bool keys[1024];
 
+//F1 prints the GL call counters of the last frame, F2 toggles the terrain depth pre-pass, F3 the overdraw view.
+//F4 starts and stops a profiler capture in debug builds, F5 writes the frame time report, F6 toggles dynamic resolution.
+bool printRenderStats = false;
+bool writeFrameReport = false;
+bool toggleCapture = false;
+RenderSettings renderSettings;
+
 const int width = 1280, height = 720;
 
+//--record <file> saves the flown camera path on exit, --replay <file> plays one back and --benchmark plays a scripted
+//fly-over. Replays run at a fixed timestep and quit at the end of the path. --headless renders offscreen without a display.
+enum class CameraMode
+{
+	Free = 0,
+	Record,
+	Replay
+};
+
+CameraMode cameraMode = CameraMode::Free;
+CameraPath cameraPath;
+const char* cameraPathFile = nullptr;
+bool headless = false;
+
+//Every replayed frame advances the path by this much, however long it took to render.
+const double replayTimestep = 1.0 / 60.0;
+
 WorldInformation worldInformation;
 
 GLuint skyBoxVao, skyBoxEbo;
@@ -61,40 +112,85 @@ struct vec2compare
 	}
 };
 
-GLuint skyBoxProgram, cubeProgram, terrainProgram, modelProgram;
+ShaderProgram skyBoxProgram, cubeProgram, terrainProgram, modelProgram, depthOnlyProgram, overdrawProgram, upscaleProgram;
+ShaderProgram terrainShadowProgram, modelShadowProgram;
 
 glm::quat camQuaternion = glm::quat(glm::vec3(glm::radians(cameraPitch), glm::radians(cameraYaw), 0.0f));
 
 std::vector<Entity> entities;
 
+//Main thread only, the render thread sees the resident chunks through the frame packets.
 std::map<glm::vec2, Plane, vec2compare> activeTerrainChunks;
 
+//Chunks the render thread finished uploading, moved into activeTerrainChunks at the start of the next main thread frame.
+std::mutex uploadedChunksMutex;
+std::vector<std::pair<glm::vec2, Plane>> uploadedChunks;
+
 const int chunkSize = 241;
 
+//Keep the generated vertices on the Plane after upload, only needed for CPU side height queries.
+const bool keepChunkCpuData = false;
+
+//Chunks the GPU can be copying out of at once, more than that fall back to a staging buffer each.
+const int stagingSegments = 16;
+
 const int xScale = 5;
 
+//Every terrain layer is resampled to this size to fit in one texture array.
+const int terrainLayerSize = 1024;
+
 int systemThreadsCount;
 const int maxViewDistance = 400;
 
-ThreadPool threadPool(std::thread::hardware_concurrency());
+ThreadPool& threadPool = ThreadPool::shared_instance();
+
+//Cancelled on shutdown so in flight chunk jobs stop at their next suspension point.
+CancellationToken streamingToken = CancellationToken::create();
+
+//Main thread fills, render thread draws. Everything in the renderer belongs to the render thread once it runs.
+FramePacketQueue framePackets;
 
 Renderer renderer;
 
+//The scene is drawn into its target and scaled up to the window.
+DynamicResolution dynamicResolution;
+
 Cube cube;
 
-int main()
+int main(int argc, char** argv)
 {
+	auto launchTime = std::chrono::steady_clock::now();
+
+	if (!parse_arguments(argc, argv))
+		return -3;
+
 	systemThreadsCount = std::thread::hardware_concurrency();
+	PROFILE_THREAD_NAME("Main");
 
 	GLFWwindow* window = nullptr;
 	auto result = initialize_window(window);
 
 	if (result != 0) return result;
 
+	//Loader context sharing objects with the window's, models, textures and chunks are uploaded on it from here on.
+	//Without one the uploads fall back to the render thread.
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	GLFWwindow* uploadWindow = glfwCreateWindow(1, 1, "Uploads", nullptr, window);
+	if (uploadWindow != nullptr)
+		UploadQueue::shared_instance().start(uploadWindow);
+	else
+		std::cout << "No upload context, uploading on the render thread." << std::endl;
+
 	create_cube(skyBoxVao, skyBoxEbo, skyBoxSize, skyBoxIndexSize);
 	create_cube(cube.VAO, cube.EBO, cube.size, cube.IndexSize);
 
+	auto shaderStart = std::chrono::steady_clock::now();
+	renderer.initialize_shader_compiler((GLADloadproc)glfwGetProcAddress);
 	create_shaders(renderer);
+	auto shaderTime = std::chrono::steady_clock::now() - shaderStart;
+
+	renderer.terrainArena.initialize(chunkSize);
+	StagingRing::shared_instance().initialize((GLADloadproc)glfwGetProcAddress, renderer.terrainArena.slot_bytes(), stagingSegments);
 
 	int count = 0;
 
@@ -102,70 +198,309 @@ int main()
 	load_textures();
 
 	initialize_world_information(worldInformation);
+	renderer.shadows.initialize(worldInformation.projection);
 
 	//Create viewport
 	glViewport(0, 0, width, height);
 
-	double deltaTime = 0.0;
-	double prevousTick = 0.0;
-	double frameRate = 0.0;
+	//Without a display there's no default framebuffer to draw into.
+	RenderTarget offscreenTarget;
+	if (headless && !offscreenTarget.create(width, height))
+		return -4;
+
+	if (!dynamicResolution.initialize(width, height, upscaleProgram))
+		return -5;
+
+	//The render thread takes the context over, everything GL from here on happens there.
+	glfwMakeContextCurrent(nullptr);
+	std::thread renderThread(render_thread, window, std::ref(offscreenTarget), launchTime, shaderTime);
+
+	uint64_t frameIndex = 0;
+	auto loopStart = std::chrono::steady_clock::now();
 
 	while (!glfwWindowShouldClose(window))
 	{
-		//Calculate DeltaTime and FrameRate.
+		PROFILE_SCOPE("Frame");
 		auto time = glfwGetTime();
-		deltaTime = time - prevousTick;
-		prevousTick = time;
-		frameRate = 1.0 / deltaTime;
 
-		//background color set & render
-		glClearColor(0, 0, 0, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		if (cameraMode == CameraMode::Replay)
+		{
+			//Fixed timestep, the same frame always sees the same camera and sun.
+			time = frameIndex * replayTimestep;
+			if (time > cameraPath.duration())
+				break;
+
+			set_camera(cameraPath.sample(time));
+		}
 
 		//input
 		process_input(window);
 
+		if (cameraMode == CameraMode::Record)
+			cameraPath.record(CameraSample{ time, worldInformation.cameraPosition, cameraYaw, cameraPitch });
+
 		//Update Sun Color.
 		worldInformation.lightPosition = glm::vec3(glm::cos(time * 0.3f), glm::sin(time * 0.3f), 0.0f);
 
-		////rendering
-		renderer.render_skybox(skyBoxProgram, worldInformation, skyBoxVao, skyBoxIndexSize);
-		renderer.render_cube(cubeProgram, worldInformation, cube);
+		receive_uploaded_chunks();
+		check_visible_planes();
+
+		//Blocks while the render thread is packetCount - 1 frames behind.
+		auto& packet = framePackets.begin_write();
+		packet.frameIndex = frameIndex;
+		packet.worldInformation = worldInformation;
+		packet.settings = renderSettings;
 
 		for (auto& entity : entities)
 		{
-			renderer.render_model(entity.model, modelProgram, worldInformation, entity.position, entity.rotation, entity.scale);
+			packet.models.push_back(ModelDraw{ entity.model, entity.position, entity.rotation, entity.scale });
 		}
 
-		for (auto& plane : activeTerrainChunks)
+		for (auto& [coordinate, plane] : activeTerrainChunks)
 		{
-			renderer.render_plane(terrainProgram, plane.second, worldInformation);
+			//Placeholder for a chunk that is still being generated.
+			if (plane.arenaSlot >= 0)
+				packet.chunks.push_back(ChunkDraw{ plane.arenaSlot, plane.position, plane.boundsMin, plane.boundsMax });
 		}
 
-		check_visible_planes();
+		packet.printRenderStats = std::exchange(printRenderStats, false);
+		packet.writeFrameReport = std::exchange(writeFrameReport, false);
+		packet.toggleCapture = std::exchange(toggleCapture, false);
+		framePackets.end_write();
 
-		glfwSwapBuffers(window);
 		glfwPollEvents();
-
-		//Clear queued functions
-		if (!ActionQueue::shared_instance().IsEmpty())
-			ActionQueue::shared_instance().ClearFunctionQueue();
+		frameIndex++;
 	}
 
-	//Dispose of entity pointers.
-	for (auto& entity : entities)
+	framePackets.close();
+	renderThread.join();
+	glfwMakeContextCurrent(window);
+	receive_uploaded_chunks();
+
+	write_frame_report();
+
+	if (cameraMode == CameraMode::Record)
+		cameraPath.save(cameraPathFile);
+
+	if (cameraMode == CameraMode::Replay)
 	{
-		delete entity.model;
+		size_t pendingChunks = std::count_if(activeTerrainChunks.begin(), activeTerrainChunks.end(), [](auto& chunk) { return chunk.second.arenaSlot < 0; });
+		std::cout << "Replayed " << frameIndex << " frames, " << cameraPath.duration() << " s of path in "
+			<< std::chrono::duration<double>(std::chrono::steady_clock::now() - loopStart).count() << " s. Chunks resident: "
+			<< renderer.terrainArena.resident_count() << ", still generating: " << pendingChunks << std::endl;
 	}
 
+#if ENABLE_PROFILER
+	if (Profiler::shared_instance().capturing())
+		Profiler::shared_instance().stop_capture("profile.json");
+#endif
+
 	//Terminate
-	threadPool.~ThreadPool();
+	streamingToken.cancel();
+
+	//Entities only borrow their models, the registry owns them.
+	entities.clear();
+	ModelRegistry::shared_instance().clear();
+
+	threadPool.shutdown();
+	threadPool.print_queue_stats(std::cout);
+	threadPool.write_stats_json("threadpool_stats.json");
+
+	auto& chunkBufferPool = ChunkBufferPool::shared_instance();
+	std::cout << "Chunk buffers allocated: " << chunkBufferPool.allocated_count() << ", free: " << chunkBufferPool.free_count() << std::endl;
+	StagingRing::shared_instance().print(std::cout);
 	glfwTerminate();
 	return 0;
 }
 
+bool parse_arguments(int argc, char** argv)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::strcmp(argv[i], "--headless") == 0)
+		{
+			headless = true;
+		}
+		else if (std::strcmp(argv[i], "--benchmark") == 0)
+		{
+			cameraMode = CameraMode::Replay;
+			cameraPath = CameraPath::flyover(glm::vec3(0.0f, 250.0f, 0.0f), glm::vec3(3000.0f, 250.0f, 3000.0f), 30.0, 20.0f);
+		}
+		else if ((std::strcmp(argv[i], "--record") == 0 || std::strcmp(argv[i], "--replay") == 0) && i + 1 < argc)
+		{
+			cameraMode = std::strcmp(argv[i], "--record") == 0 ? CameraMode::Record : CameraMode::Replay;
+			cameraPathFile = argv[++i];
+
+			if (cameraMode == CameraMode::Replay && !cameraPath.load(cameraPathFile))
+				return false;
+		}
+		else
+		{
+			std::cout << "Unknown argument " << argv[i] << ", expected --record <file>, --replay <file>, --benchmark or --headless" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+void set_camera(const CameraSample& sample)
+{
+	cameraYaw = sample.yaw;
+	cameraPitch = sample.pitch;
+	camQuaternion = glm::quat(glm::vec3(glm::radians(cameraPitch), glm::radians(cameraYaw), 0.0f));
+
+	glm::vec3 camForward = camQuaternion * glm::vec3(0, 0, 1);
+	glm::vec3 camUp = camQuaternion * glm::vec3(0, 1, 0);
+
+	worldInformation.cameraPosition = sample.position;
+	worldInformation.view = glm::lookAt(worldInformation.cameraPosition, worldInformation.cameraPosition + camForward, camUp);
+}
+
+void write_frame_report()
+{
+	auto& frameStats = FrameStats::shared_instance();
+	frameStats.print(std::cout);
+	frameStats.write_csv("frame_stats.csv");
+	frameStats.write_json("frame_stats.json");
+}
+
+//Owns the GL context while it runs. Draws the packets in order, finishes the uploads the GPU is done with before each
+//frame and runs the queued actions after it.
+void render_thread(GLFWwindow* window, RenderTarget& offscreenTarget, std::chrono::steady_clock::time_point launchTime, std::chrono::steady_clock::duration shaderTime)
+{
+	PROFILE_THREAD_NAME("Render");
+	glfwMakeContextCurrent(window);
+	bool firstFrame = true;
+	bool statsPrintPending = false;
+
+	while (FramePacket* packet = framePackets.begin_read())
+	{
+		//Hides the main thread's copy, which keeps changing while this frame is drawn.
+		auto& worldInformation = packet->worldInformation;
+
+		//The overdraw figure comes from occlusion queries that are read a few frames late, so the print waits for one.
+		statsPrintPending |= packet->printRenderStats;
+		if (statsPrintPending && renderer.samples_ready())
+		{
+			statsPrintPending = false;
+			RenderStats::shared_instance().print(std::cout);
+			std::cout << "Scene resolution: " << dynamicResolution.render_width() << "x" << dynamicResolution.render_height() << " (" << dynamicResolution.scale()
+				<< "), scene GPU time: " << dynamicResolution.gpu_ms() << " ms" << std::endl;
+			StagingRing::shared_instance().print(std::cout);
+		}
+		RenderStats::shared_instance().reset();
+
+		//Never blocks, whatever the GPU hasn't finished yet waits for a later frame.
+		size_t finishedUploads = UploadQueue::shared_instance().collect();
+		StagingRing::shared_instance().reclaim();
+
+#if ENABLE_PROFILER
+		if (packet->toggleCapture)
+		{
+			auto& profiler = Profiler::shared_instance();
+			if (profiler.capturing())
+				profiler.stop_capture("profile.json");
+			else
+				profiler.start_capture();
+		}
+#endif
+
+		{
+			PROFILE_SCOPE("Render frame");
+			renderer.begin_frame();
+			renderer.depthPrepass = packet->settings.depthPrepass;
+			renderer.showOverdraw = packet->settings.showOverdraw;
+			renderer.measureSamples = packet->settings.showOverdraw || statsPrintPending;
+			dynamicResolution.enabled = packet->settings.dynamicResolution;
+
+			renderer.update_frame_uniforms(worldInformation);
+
+			////rendering
+			renderer.submit_skybox(skyBoxProgram, worldInformation, skyBoxVao, skyBoxIndexSize);
+			renderer.submit_cube(cubeProgram, worldInformation, cube);
+
+			for (auto& model : packet->models)
+			{
+				renderer.submit_model(model.model, worldInformation, model.position, model.rotation, model.scale);
+			}
+			renderer.submit_instances(modelProgram);
+
+			for (auto& chunk : packet->chunks)
+			{
+				renderer.submit_chunk(chunk, worldInformation);
+			}
+			renderer.submit_terrain(terrainProgram, depthOnlyProgram);
+
+			//Shadow maps have their own framebuffer, drawn before the scene's is bound.
+			renderer.render_shadows(worldInformation, terrainShadowProgram, modelShadowProgram);
+
+			dynamicResolution.begin_frame();
+
+			//background color set & render
+			glClearColor(0, 0, 0, 1.0f);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+			renderer.flush();
+
+			dynamicResolution.end_frame();
+			{
+				PROFILE_GPU_SCOPE("Upscale");
+				dynamicResolution.present(renderer.state, headless ? offscreenTarget.framebuffer : 0);
+			}
+		}
+
+		//The packet isn't read past this point, the main thread can start filling it again.
+		bool writeReport = packet->writeFrameReport;
+		framePackets.end_read();
+
+		{
+			PROFILE_SCOPE("Swap buffers");
+			//Offscreen nothing waits on the GPU, finish so the frame time still covers the whole frame.
+			if (headless)
+				glFinish();
+			else
+				glfwSwapBuffers(window);
+		}
+
+		if (firstFrame)
+		{
+			using Milliseconds = std::chrono::duration<double, std::milli>;
+			auto& cacheStats = renderer.programCache.stats();
+			std::cout << "Launch to first frame: " << Milliseconds(std::chrono::steady_clock::now() - launchTime).count() << " ms, shaders: "
+				<< Milliseconds(shaderTime).count() << " ms (" << cacheStats.hits << " cached, " << cacheStats.misses + cacheStats.rejected
+				<< " compiled, " << cacheStats.rejected << " rejected)" << std::endl;
+			firstFrame = false;
+		}
+
+		//Clear queued functions, uploads among them when there's no upload context.
+		FrameRecord frameRecord;
+		frameRecord.finishedUploads = finishedUploads;
+		if (!ActionQueue::shared_instance().IsEmpty())
+			frameRecord.queuedActions = ActionQueue::shared_instance().ClearFunctionQueue();
+
+		auto& renderStats = RenderStats::shared_instance();
+		frameRecord.drawCalls = renderStats.drawCalls;
+		frameRecord.chunksUploaded = renderStats.chunksUploaded;
+		frameRecord.bytesUploaded = renderStats.bytesUploaded;
+		frameRecord.frameDataBytes = renderStats.frameDataBytes;
+		frameRecord.sceneGpuMs = dynamicResolution.gpu_ms();
+		frameRecord.resolutionScale = dynamicResolution.scale();
+		FrameStats::shared_instance().end_frame(frameRecord);
+
+		if (writeReport)
+			write_frame_report();
+	}
+
+	//While the context is still here to delete the fences with, and before the models the uploads fill in go away.
+	UploadQueue::shared_instance().shutdown();
+	StagingRing::shared_instance().shutdown();
+	glfwMakeContextCurrent(nullptr);
+}
+
 void check_visible_planes()
 {
+	PROFILE_SCOPE("Stream chunks");
+
 	const int size = chunkSize - 1;
 	auto visibleChunks = static_cast<int>(std::round(maxViewDistance / size));
 	const float chunkOffset = size * xScale;
@@ -187,13 +522,14 @@ void check_visible_planes()
 			else
 			{
 				glm::vec3 chunkWorldPos = glm::vec3(currentChunkCord.x * chunkOffset, 0.0f, currentChunkCord.y * chunkOffset);
-				activeTerrainChunks.insert({ currentChunkCord, Plane() });
+				activeTerrainChunks.try_emplace(currentChunkCord);
+
+				//The inner half of the view distance streams first, the outer ring waits until it has aged past its threshold.
+				bool nearCamera = std::max(std::abs(xOffset), std::abs(yOffset)) <= visibleChunks / 2;
+				auto priority = nearCamera ? TaskPriority::Streaming : TaskPriority::Background;
 
-				//Queue it to the threadpool for execution.
-				threadPool.enqueue([=]()
-					{
-						generate_landscape_chunk(currentChunkCord, chunkWorldPos, chunkSize, 400.0f, xScale, chunkWorldPos, 1);
-					});
+				//The coroutine moves itself onto the threadpool.
+				generate_landscape_chunk(currentChunkCord, chunkWorldPos, chunkSize, 400.0f, xScale, chunkWorldPos, streamingToken, priority, 1).detach();
 			}
 		}
 	}
@@ -203,22 +539,20 @@ void load_models(std::vector<Entity>& entities)
 {
 	Entity templeEntity{};
 
-	templeEntity.model = new Model("Resources/Models/Japanese_Temple_Model/Japanese_Temple.obj");
+	//Temple doesn't need the uvs to be flipped. Backpack Does.
+	templeEntity.model = ModelRegistry::shared_instance().load_async("Resources/Models/Japanese_Temple_Model/Japanese_Temple.obj", false, VertexFormat::Packed);
 	templeEntity.position = glm::vec3(500, 0, 500);
 	templeEntity.rotation = glm::vec3(0, 0.1f, 0.0f);
 	templeEntity.scale = glm::vec3(25);
 
-	//Temple doesn't need the uvs to be flipped. Backpack Does.
-	stbi_set_flip_vertically_on_load(true);
-
 	Entity backPack{};
 
-	backPack.model = new Model("Resources/Models/backpack/backpack.obj");
+	backPack.model = ModelRegistry::shared_instance().load_async("Resources/Models/backpack/backpack.obj", true, VertexFormat::Packed);
 	backPack.position = glm::vec3(750, 150, 750);
 	backPack.rotation = glm::vec3(0);
 	backPack.scale = glm::vec3(50);
 
-	std::cout << "Finished Loading Models" << std::endl;
+	std::cout << "Queued " << ModelRegistry::shared_instance().size() << " models for upload" << std::endl;
 
 	entities.push_back(backPack);
 	entities.push_back(templeEntity);
@@ -226,10 +560,19 @@ void load_models(std::vector<Entity>& entities)
 
 void create_shaders(Renderer& renderer)
 {
+	renderer.create_programs({
+		{ &cubeProgram, "Resources/Shaders/simpleVertexShader.glsl", "Resources/Shaders/simpleFragmentShader.glsl" },
+		{ &skyBoxProgram, "Resources/Shaders/skyVertexShader.glsl", "Resources/Shaders/skyFragmentShader.glsl" },
+		{ &terrainProgram, "Resources/Shaders/simpleTerrainVertex.glsl", "Resources/Shaders/simpleTerrainFragment.glsl" },
+		{ &modelProgram, "Resources/Shaders/modelVertex.glsl", "Resources/Shaders/modelFragment.glsl" },
+		{ &depthOnlyProgram, "Resources/Shaders/depthOnlyVertex.glsl", "Resources/Shaders/depthOnlyFragment.glsl" },
+		{ &overdrawProgram, "Resources/Shaders/overdrawVertex.glsl", "Resources/Shaders/overdrawFragment.glsl" },
+		{ &upscaleProgram, "Resources/Shaders/upscaleVertex.glsl", "Resources/Shaders/upscaleFragment.glsl" },
+		{ &terrainShadowProgram, "Resources/Shaders/shadowVertex.glsl", "Resources/Shaders/depthOnlyFragment.glsl" },
+		{ &modelShadowProgram, "Resources/Shaders/shadowModelVertex.glsl", "Resources/Shaders/depthOnlyFragment.glsl" } });
+
 	renderer.Intialize(cubeProgram);
-	renderer.createProgram(skyBoxProgram, "Resources/Shaders/skyVertexShader.glsl", "Resources/Shaders/skyFragmentShader.glsl");
-	renderer.createProgram(terrainProgram, "Resources/Shaders/simpleTerrainVertex.glsl", "Resources/Shaders/simpleTerrainFragment.glsl");
-	renderer.createProgram(modelProgram, "Resources/Shaders/modelVertex.glsl", "Resources/Shaders/modelFragment.glsl");
+	renderer.initialize_overdraw(overdrawProgram);
 }
 
 void key_call_back(GLFWwindow* window, int key, int scancode, int action, int mods)
@@ -237,6 +580,31 @@ void key_call_back(GLFWwindow* window, int key, int scancode, int action, int mo
 	if (action == GLFW_PRESS)
 	{
 		keys[key] = true;
+
+		if (key == GLFW_KEY_F1)
+			printRenderStats = true;
+
+		if (key == GLFW_KEY_F2)
+		{
+			renderSettings.depthPrepass = !renderSettings.depthPrepass;
+			std::cout << "Depth pre-pass " << (renderSettings.depthPrepass ? "on" : "off") << std::endl;
+		}
+
+		if (key == GLFW_KEY_F3)
+			renderSettings.showOverdraw = !renderSettings.showOverdraw;
+
+		if (key == GLFW_KEY_F5)
+			writeFrameReport = true;
+
+		if (key == GLFW_KEY_F6)
+		{
+			renderSettings.dynamicResolution = !renderSettings.dynamicResolution;
+			std::cout << "Dynamic resolution " << (renderSettings.dynamicResolution ? "on" : "off") << std::endl;
+		}
+
+		//The capture reads GPU timestamps, the render thread starts and stops it.
+		if (key == GLFW_KEY_F4)
+			toggleCapture = true;
 	}
 	else if (action == GLFW_RELEASE)
 	{
@@ -246,36 +614,51 @@ void key_call_back(GLFWwindow* window, int key, int scancode, int action, int mo
 
 void load_textures()
 {
-	//Textures for the terrain.
-	renderer.dirt = FileLoader::load_GL_texture("Resources/Textures/dirt.jpg");
-	renderer.sand = FileLoader::load_GL_texture("Resources/Textures/sand.jpg");
-	renderer.grass = FileLoader::load_GL_texture("Resources/Textures/grass.png", 4);
-	renderer.rock = FileLoader::load_GL_texture("Resources/Textures/rock.jpg");
-	renderer.snow = FileLoader::load_GL_texture("Resources/Textures/snow.jpg");
+	//The textures themselves arrive later, the samplers only need the units.
+	upload_textures().detach();
 
 	glUseProgram(terrainProgram);
 
-	glUniform1i(glGetUniformLocation(terrainProgram, "dirt"), 0);
-	glUniform1i(glGetUniformLocation(terrainProgram, "sand"), 1);
-	glUniform1i(glGetUniformLocation(terrainProgram, "grass"), 2);
-	glUniform1i(glGetUniformLocation(terrainProgram, "rock"), 3);
-	glUniform1i(glGetUniformLocation(terrainProgram, "snow"), 4);
+	terrainProgram.set_sampler("layers", 0);
+	terrainProgram.set_sampler("shadowMap", ShadowCascades::textureUnit);
 
 	//Texture setup for the models.
 	glUseProgram(modelProgram);
 
-	glUniform1i(glGetUniformLocation(modelProgram, "texture_diffuse1"), 0);
-	glUniform1i(glGetUniformLocation(modelProgram, "texture_specular1"), 1);
-	glUniform1i(glGetUniformLocation(modelProgram, "texture_normal1"), 2);
-	glUniform1i(glGetUniformLocation(modelProgram, "texture_roughness1"), 3);
-	glUniform1i(glGetUniformLocation(modelProgram, "texture_ao1"), 4);
+	//Every texture type has a fixed unit, meshes bind straight to it without touching the samplers.
+	for (size_t type = 0; type < static_cast<size_t>(TextureType::Count); ++type)
+		modelProgram.set_sampler(textureSamplerNames[type], texture_unit(static_cast<TextureType>(type)));
+	modelProgram.set_sampler("shadowMap", ShadowCascades::textureUnit);
+}
+
+Task upload_textures()
+{
+	auto& uploads = UploadQueue::shared_instance();
+	co_await uploads.schedule();
+
+	stbi_set_flip_vertically_on_load(true);
+
+	//Textures for the terrain.
+	//Layer order has to match the splat weights, see pack_splat_weights.
+	auto terrainLayers = FileLoader::load_GL_texture_array({
+		"Resources/Textures/dirt.jpg",
+		"Resources/Textures/sand.jpg",
+		"Resources/Textures/grass.png",
+		"Resources/Textures/rock.jpg",
+		"Resources/Textures/snow.jpg" }, terrainLayerSize, 4);
 
 	//Textures for the Box.
 	auto cubeDiffuse = FileLoader::load_GL_texture("Resources/Textures/container2.png");
 	auto cubeNormal = FileLoader::load_GL_texture("Resources/Textures/container2_normal.png");
 
+	//Render thread from here, the materials are only read there. Until now they drew untextured.
+	co_await uploads.completion();
+
+	renderer.terrainLayers = terrainLayers;
 	cube.Textures.push_back(cubeDiffuse);
 	cube.Textures.push_back(cubeNormal);
+
+	renderer.create_materials(cube);
 }
 
 void initialize_world_information(WorldInformation& worldInformation)
@@ -291,6 +674,10 @@ void initialize_world_information(WorldInformation& worldInformation)
 
 void mouse_call_back(GLFWwindow* window, double xPos, double yPos)
 {
+	//The path owns the camera during a replay.
+	if (cameraMode == CameraMode::Replay)
+		return;
+
 	//Op basis van pitch en yaw roteren we een genormalizeerde vector3.
 	float x = (float)xPos;
 	float y = (float)yPos;
@@ -337,6 +724,9 @@ void process_input(GLFWwindow*& window)
 		glfwSetWindowShouldClose(window, true);
 	}
 
+	if (cameraMode == CameraMode::Replay)
+		return;
+
 	bool camChanged = false;
 	if (keys[GLFW_KEY_W])
 	{
@@ -369,6 +759,10 @@ void process_input(GLFWwindow*& window)
 
 int initialize_window(GLFWwindow*& window)
 {
+	//The null platform needs no display, with an EGL context it runs on a surfaceless device such as llvmpipe.
+	if (headless)
+		glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+
 	if (!glfwInit())
 	{
 		std::cout << "Failed to Initialize GLFW." << std::endl;
@@ -379,6 +773,14 @@ int initialize_window(GLFWwindow*& window)
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	//The overdraw view counts fragments in the stencil buffer.
+	glfwWindowHint(GLFW_STENCIL_BITS, 8);
+
+	if (headless)
+	{
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+	}
 
 	int windowWidth = width;
 	int windowHeight = height;
@@ -510,6 +912,25 @@ void create_cube(GLuint& VAO, GLuint& EBO, int& size, int& numIndices)
 	glEnableVertexAttribArray(5);
 }
 
+//The height ramps the terrain shader used to blend its layers with, folded into one weight per layer.
+//Sand, grass, rock and snow go out as unorm bytes, dirt is whatever remains. Returned as bits, not a float,
+//so it can't be touched by float conversions on its way into the vertex.
+static uint32_t pack_splat_weights(float y)
+{
+	float ds = std::clamp((y + 25) * 0.1f, 0.0f, 1.0f);
+	float sg = std::clamp(y * 0.1f, 0.0f, 1.0f);
+	float gr = std::clamp((y - 25) * 0.1f, 0.0f, 1.0f);
+	float rs = std::clamp((y - 50) * 0.1f, 0.0f, 1.0f);
+
+	float snow = rs;
+	float rock = gr * (1.0f - rs);
+	float grass = sg * (1.0f - gr) * (1.0f - rs);
+	float sand = ds * (1.0f - sg) * (1.0f - gr) * (1.0f - rs);
+
+	auto to_byte = [](float weight) { return static_cast<uint32_t>(weight * 255.0f + 0.5f); };
+	return to_byte(sand) | to_byte(grass) << 8 | to_byte(rock) << 16 | to_byte(snow) << 24;
+}
+
 static inline glm::vec3 get_vertex(const std::vector<float>& vertices, const int width, const int x, const int z, const int stride) {
 	int index = (z * width + x) * stride;
 	return glm::vec3(vertices[index], vertices[index + 1], vertices[index + 2]);
@@ -557,157 +978,153 @@ static void calculate_normals(std::vector<float>& vertices, const int stride, co
 	}
 }
 
-void process_plane(const glm::vec2 currentChunkCord, const glm::vec3 position, const std::vector<unsigned int>& indices, const std::vector<float>& vertices)
+//Runs on the render thread, the place holder in activeTerrainChunks is filled in once the main thread picks it up.
+//The vertices are already on the GPU, in a staging buffer or a ring segment, only the copy into the arena is left.
+void process_plane(ChunkPayload&& payload, GLuint sourceBuffer, GLintptr sourceOffset)
 {
-	const int stride = 8;
-	unsigned int VAO, VBO, EBO;
+	PROFILE_SCOPE("Chunk upload");
 
-	glGenVertexArrays(1, &VAO);
-	glGenBuffers(1, &VBO);
-	glGenBuffers(1, &EBO);
+	Plane plane;
+	plane.arenaSlot = renderer.terrainArena.allocate(sourceBuffer, sourceOffset);
+	plane.position = payload.position;
+	plane.boundsMin = payload.boundsMin;
+	plane.boundsMax = payload.boundsMax;
 
-	glBindVertexArray(VAO);
+	//Cached shadow cascades that can see the new chunk have to draw it.
+	renderer.shadows.invalidate_region(plane.boundsMin, plane.boundsMax);
 
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), &vertices[0], GL_STATIC_DRAW);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+	plane.cpuData = std::move(payload.buffers);
 
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(float) * stride, 0);
-	glEnableVertexAttribArray(0);
-
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(float) * stride, (void*)(sizeof(float) * 3));
-	glEnableVertexAttribArray(1);
-
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(float) * stride, (void*)(sizeof(float) * 6));
-	glEnableVertexAttribArray(2);
-
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
-
-	Plane plane{};
+	std::unique_lock<std::mutex> lock(uploadedChunksMutex);
+	uploadedChunks.emplace_back(payload.coordinate, std::move(plane));
+}
 
-	plane.VAO = VAO;
-	plane.EBO = EBO;
-	plane.vertices = vertices;
-	plane.indices = indices;
-	plane.position = position;
+void receive_uploaded_chunks()
+{
+	std::vector<std::pair<glm::vec2, Plane>> received;
+	{
+		std::unique_lock<std::mutex> lock(uploadedChunksMutex);
+		received.swap(uploadedChunks);
+	}
 
-	//Replace the place holder placed during the dispatch, with the generated plane.
-	activeTerrainChunks.insert_or_assign(currentChunkCord, std::move(plane));
+	//Fill in the place holders placed during the dispatch.
+	for (auto& [coordinate, plane] : received)
+		activeTerrainChunks[coordinate] = std::move(plane);
 }
 
-void generate_landscape_chunk(const glm::vec2 currentChunkCord, const glm::vec3 position, const int size, float hScale, float xzScale, glm::vec3 offset, int concurrencyLevel)
+Task generate_landscape_chunk(const glm::vec2 currentChunkCord, const glm::vec3 position, const int size, float hScale, float xzScale, glm::vec3 offset, CancellationToken token, TaskPriority priority, int concurrencyLevel)
 {
-	const int stride = 8;
+	//Hop onto a worker, the caller only pays for starting the coroutine.
+	if (!co_await threadPool.schedule(token, priority))
+		co_return;
+
+	const int stride = TerrainArena::stride;
 	int count = size * size;
 
 	const int gridSize = 400;
 	const int octaves = 8;
 
-	std::vector<float> vertices(count * stride);
-	std::vector<unsigned int> indices((size - 1) * (size - 1) * 6);
+	//Recycled storage, it returns to the pool once the payload lets go of it, after the upload or on cancellation.
+	ChunkPayload payload{ currentChunkCord, position, ChunkBufferPool::shared_instance().acquire(count * stride) };
+	auto& vertices = payload.buffers->vertices;
 
-	//Calculate Batch Size based on concurrency level.
-	int threadCount = concurrencyLevel < 1 || concurrencyLevel > systemThreadsCount - 1 ? systemThreadsCount - 1 : concurrencyLevel;
-	int batchSize = count / threadCount;
-	int batches = count / batchSize;
+	//Calculate Batch Size based on concurrency level, the last batch also takes the remainder.
+	int batches = concurrencyLevel < 1 || concurrencyLevel > systemThreadsCount - 1 ? systemThreadsCount - 1 : concurrencyLevel;
+	int batchSize = count / batches;
 
-	std::vector<std::thread> threads;
+	co_await Parallel::parallelForAsync(0, batches, [&](int batch)
+		{
+			PROFILE_SCOPE("Chunk generation");
 
-	//Process Primary Batches.
-	for (int i = 0; i < batches; i++)
-	{
-		int start = i * batchSize;
+			int start = batch * batchSize;
+			int end = batch == batches - 1 ? count : start + batchSize;
+			int vertexIndex = start * stride;
 
-		threads.emplace_back([=, &vertices]()
+			for (int loopIndex = start; loopIndex < end; ++loopIndex)
 			{
-				int vertexIndex = start * 8;
+				int x = loopIndex % size;
+				int z = loopIndex / size;
 
-				for (int loopIndex = start; loopIndex < start + batchSize; ++loopIndex)
-				{
-					int x = loopIndex % size;
-					int z = loopIndex / size;
+				float globalX = x * xzScale;
+				float globalZ = z * xzScale;
 
-					float globalX = x * xzScale;
-					float globalZ = z * xzScale;
+				//World space, all chunks share one vertex array in the TerrainArena.
+				vertices[vertexIndex++] = position.x + globalX;
+				float perlinValue = perlin_noise::octaved_perlin_noise(globalX + offset.x, globalZ + offset.z, octaves, gridSize);
 
-					vertices[vertexIndex++] = globalX;
-					float perlinValue = perlin_noise::octaved_perlin_noise(globalX + offset.x, globalZ + offset.z, octaves, gridSize);
+				float height = position.y + perlinValue * hScale;
+				vertices[vertexIndex++] = height;
+				vertices[vertexIndex++] = position.z + globalZ;
 
-					vertices[vertexIndex++] = perlinValue * hScale;
-					vertices[vertexIndex++] = globalZ;
+				vertices[vertexIndex++] = 0.0f;
+				vertices[vertexIndex++] = 0.0f;
+				vertices[vertexIndex++] = 0.0f;
 
-					vertices[vertexIndex++] = 0.0f;
-					vertices[vertexIndex++] = 0.0f;
-					vertices[vertexIndex++] = 0.0f;
+				vertices[vertexIndex++] = x / (float)size;
+				vertices[vertexIndex++] = z / (float)size;
 
-					vertices[vertexIndex++] = x / (float)size;
-					vertices[vertexIndex++] = z / (float)size;
-				}
-			});
-	}
+				uint32_t splat = pack_splat_weights(height);
+				std::memcpy(&vertices[vertexIndex++], &splat, sizeof(splat));
+			}
+		}, threadPool, priority);
 
-	//Process Remainder while other batches are being processed.
-	int remaining = count % threadCount;
+	if (token.is_cancelled())
+		co_return;
 
-	if (remaining > 0)
 	{
-		int start = count - remaining;
-		int vertexIndex = start * 8;
-
-		for (int i = start; i < start + remaining; ++i)
-		{
-			int x = i % size;
-			int z = i / size;
-
-			float globalX = x * xzScale;
-			float globalZ = z * xzScale;
-
-			vertices[vertexIndex++] = globalX;
-			float perlinValue = perlin_noise::octaved_perlin_noise(globalX + offset.x, globalZ + offset.z, octaves, gridSize);
-
-			vertices[vertexIndex++] = perlinValue * hScale;
-			vertices[vertexIndex++] = globalZ;
+		PROFILE_SCOPE("Chunk normals");
+		calculate_normals(vertices, stride, size, size);
+	}
 
-			glm::vec3 cross = glm::cross(glm::vec3(1), glm::vec3(1));
+	float minHeight = std::numeric_limits<float>::max();
+	float maxHeight = std::numeric_limits<float>::lowest();
+	for (int i = 0; i < count; ++i)
+	{
+		minHeight = std::min(minHeight, vertices[i * stride + 1]);
+		maxHeight = std::max(maxHeight, vertices[i * stride + 1]);
+	}
+	payload.boundsMin = glm::vec3(position.x, minHeight, position.z);
+	payload.boundsMax = glm::vec3(position.x + (size - 1) * xzScale, maxHeight, position.z + (size - 1) * xzScale);
+
+	//Straight into mapped memory when the ring has a segment free, no GL call until the render thread copies it out.
+	auto& stagingRing = StagingRing::shared_instance();
+	int segment = stagingRing.acquire();
+	//A write only fails once the render thread has shut the ring down, the segment went with it.
+	if (segment >= 0 && stagingRing.write(segment, vertices.data(), vertices.size() * sizeof(float)))
+	{
 
-			vertices[vertexIndex++] = 0.0f;
-			vertices[vertexIndex++] = 0.0f;
-			vertices[vertexIndex++] = 0.0f;
+		if (!keepChunkCpuData)
+			payload.buffers.reset();
 
-			vertices[vertexIndex++] = x / (float)size;
-			vertices[vertexIndex++] = z / (float)size;
+		if (!co_await ActionQueue::shared_instance().schedule(token))
+		{
+			stagingRing.release(segment);
+			co_return;
 		}
-	}
 
-	for (auto& thread : threads)
-	{
-		thread.join();
+		process_plane(std::move(payload), stagingRing.buffer(), stagingRing.offset(segment));
+		stagingRing.fence(segment);
+		co_return;
 	}
-	threads.clear();
 
-	unsigned int index = 0;
-	for (unsigned int i = 0; i < (size - 1) * (size - 1); ++i)
-	{
-		int x = i % (size - 1);
-		int z = i / (size - 1);
+	//No ring, or the GPU still holds every segment. Upload on the loader context instead.
+	auto& uploads = UploadQueue::shared_instance();
+	if (!co_await uploads.schedule(token))
+		co_return;
 
-		int vertex = z * size + x;
+	GLuint stagingBuffer = TerrainArena::create_staging(vertices);
 
-		indices[index++] = vertex;
-		indices[index++] = vertex + size;
-		indices[index++] = vertex + size + 1;
-		indices[index++] = vertex;
-		indices[index++] = vertex + size + 1;
-		indices[index++] = vertex + 1;
-	}
+	//glBufferData took its own copy, the storage can go back to the pool before the render thread gets to it.
+	if (!keepChunkCpuData)
+		payload.buffers.reset();
 
-	calculate_normals(vertices, stride, size, size);
+	if (!co_await uploads.completion(token))
+	{
+		glDeleteBuffers(1, &stagingBuffer);
+		co_return;
+	}
 
-	//Deffer finalization to the main thread.
-	ActionQueue::shared_instance().AddActionToQueue([=, indices = std::move(indices), vertices = std::move(vertices)]() mutable
-		{
-			process_plane(currentChunkCord, position, indices, vertices);
-		});
+	//The payload lives in the coroutine frame, so the hops themselves didn't copy anything.
+	process_plane(std::move(payload), stagingBuffer, 0);
+	glDeleteBuffers(1, &stagingBuffer);
 }
\ No newline at end of file
@@ -6,12 +6,22 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <array>
+#include <cmath>
+#include <cstdint>
 #include <string>
+#include <utility>
 #include <vector>
+#include "RenderStats.h"
+#include "RenderState.h"
+#include "ShaderProgram.h"
 using namespace std;
 
 #define MAX_BONE_INFLUENCE 4
 
+// first of the four locations the per instance world matrix occupies, one vec4 column each
+#define INSTANCE_MATRIX_LOCATION 7
+
 struct Vertex {
     // position
     glm::vec3 Position;
@@ -29,97 +39,186 @@ struct Vertex {
     float m_Weights[MAX_BONE_INFLUENCE];
 };
 
+// Vertex squeezed from 88 into 20 bytes for meshes without bones. only what the model shaders read is kept: the
+// normal is 10_10_10_2, uvs are half floats, fine for 0..1 but coarse for uvs that tile far past it.
+struct PackedVertex {
+    glm::vec3 Position;
+    uint32_t Normal;
+    uint32_t TexCoords;
+};
+static_assert(sizeof(PackedVertex) == 20, "PackedVertex has to stay tightly packed");
+
+// how a mesh stores its vertices on the GPU, picked when the model is loaded
+enum class VertexFormat {
+    Full = 0,
+    Packed
+};
+
+// four signed normalized components in the GL_INT_2_10_10_10_REV layout, x in the low bits and w in the top two
+inline uint32_t pack_snorm_10_10_10_2(const glm::vec4& v)
+{
+    auto component = [](float value, int bits) {
+        float maxValue = static_cast<float>((1 << (bits - 1)) - 1);
+        int quantized = static_cast<int>(std::round(glm::clamp(value, -1.0f, 1.0f) * maxValue));
+        return static_cast<uint32_t>(quantized) & ((1u << bits) - 1);
+    };
+    return component(v.x, 10) | component(v.y, 10) << 10 | component(v.z, 10) << 20 | component(v.w, 2) << 30;
+}
+
+// the value doubles as the texture unit the type is always bound to
+enum class TextureType {
+    Diffuse = 0,
+    Specular,
+    Normal,
+    Roughness,
+    AmbientOcclusion,
+    Height,
+    Count
+};
+
+// sampler each type is read through, the shaders only declare the first texture of every type
+inline const char* const textureSamplerNames[] = {
+    "texture_diffuse1",
+    "texture_specular1",
+    "texture_normal1",
+    "texture_roughness1",
+    "texture_ao1",
+    "texture_height1",
+};
+
+inline GLuint texture_unit(TextureType type) { return static_cast<GLuint>(type); }
+
+// one bit per texture unit whose sampler is active in the program. a sampler the shader declares but never reads is
+// optimized out, so its type is left out too
+inline uint32_t sampled_texture_units(const ShaderProgram& program)
+{
+    uint32_t units = 0;
+    for (size_t type = 0; type < static_cast<size_t>(TextureType::Count); type++)
+    {
+        if (program.find_location(textureSamplerNames[type]) >= 0)
+            units |= 1u << texture_unit(static_cast<TextureType>(type));
+    }
+    return units;
+}
+
+// 1x1 stand in for every texture type, bound in place of the types a mesh doesn't have so it never samples whatever
+// the previous draw left on that unit. white diffuse and ao, no specular, a flat normal, zero roughness and height.
+// made by the first mesh that needs them, on whichever context that runs on, they are shared like any other texture.
+inline GLuint default_texture(TextureType type)
+{
+    static const std::array<GLuint, static_cast<size_t>(TextureType::Count)> textures = [] {
+        const unsigned char texels[][4] = {
+            { 255, 255, 255, 255 },
+            { 0, 0, 0, 255 },
+            { 128, 128, 255, 255 },
+            { 0, 0, 0, 255 },
+            { 255, 255, 255, 255 },
+            { 0, 0, 0, 255 },
+        };
+
+        std::array<GLuint, static_cast<size_t>(TextureType::Count)> ids{};
+        glGenTextures(static_cast<GLsizei>(ids.size()), ids.data());
+        for (size_t i = 0; i < ids.size(); i++)
+        {
+            glBindTexture(GL_TEXTURE_2D, ids[i]);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, texels[i]);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return ids;
+    }();
+    return textures[static_cast<size_t>(type)];
+}
+
 struct Texture {
     unsigned int id;
-    string type;
+    TextureType type;
     string path;
 };
 
+// one resolved texture bind, built when the mesh is created
+struct TextureBinding {
+    GLuint unit;
+    GLuint texture;
+};
+
 class Mesh {
 public:
-    // mesh Data
+    // mesh Data. the vertices only live on the CPU until they are in the vertex buffer, the count is kept
     vector<Vertex>       vertices;
+    size_t               vertexCount = 0;
     vector<unsigned int> indices;
     vector<Texture>      textures;
+    // what Draw binds, resolved from the textures once so drawing does no lookups
+    vector<TextureBinding> bindings;
     unsigned int VAO;
+    VertexFormat format;
 
     // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, VertexFormat format = VertexFormat::Full)
     {
-        this->vertices = vertices;
+        this->vertices = std::move(vertices);
+        this->vertexCount = this->vertices.size();
         this->indices = indices;
         this->textures = textures;
+        this->format = format;
 
-        // now that we have all the required data, set the vertex buffers and its attribute pointers.
+        // now that we have all the required data, fill the vertex buffers. the attribute pointers live in the
+        // vertex array, which setupVertexArray makes on the context that draws.
         setupMesh();
+        setupBindings();
     }
 
-    // render the mesh
-    void Draw(unsigned int program)
+    // render the mesh, instanceCount copies with their world matrices taken from the instance buffer.
+    // textureUnits is sampled_texture_units of the bound program, units it doesn't read aren't bound
+    void Draw(RenderState& state, GLsizei instanceCount = 1, uint32_t textureUnits = ~0u)
     {
-        // bind appropriate textures
-        unsigned int diffuseNr = 1;
-        unsigned int specularNr = 1;
-        unsigned int normalNr = 1;
-        unsigned int heightNr = 1;
-        unsigned int roughnessNr = 1;
-        unsigned int ambientOcclusionNr = 1;
-        for (unsigned int i = 0; i < textures.size(); i++)
+        // bind the textures to the units their samplers were pointed at when the program was loaded
+        for (const auto& binding : bindings)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
-            string number;
-            string name = textures[i].type;
-            if (name == "texture_diffuse")
-                number = std::to_string(diffuseNr++);
-            else if (name == "texture_specular")
-                number = std::to_string(specularNr++); // transfer unsigned int to string
-            else if (name == "texture_normal")
-                number = std::to_string(normalNr++); // transfer unsigned int to string
-            else if (name == "texture_height")
-                number = std::to_string(heightNr++); // transfer unsigned int to string
-            else if (name == "texture_roughness")
-                number = std::to_string(roughnessNr++); // transfer unsigned int to string
-            else if (name == "texture_ao")
-                number = std::to_string(ambientOcclusionNr++); // transfer unsigned int to string
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(program, (name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            if (textureUnits & (1u << binding.unit))
+                state.bind_texture(binding.unit, GL_TEXTURE_2D, binding.texture);
         }
 
         // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
+        state.bind_vertex_array(VAO);
+        glDrawElementsInstanced(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0, instanceCount);
+        RenderStats::shared_instance().drawCalls++;
+        RenderStats::shared_instance().instances += instanceCount;
+    }
 
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+    // same draw without the textures, for passes that only write depth
+    void DrawDepth(RenderState& state, GLsizei instanceCount = 1)
+    {
+        state.bind_vertex_array(VAO);
+        glDrawElementsInstanced(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0, instanceCount);
+        RenderStats::shared_instance().drawCalls++;
+        RenderStats::shared_instance().instances += instanceCount;
     }
 
-private:
-    // render data 
-    unsigned int VBO, EBO;
+    // bytes the vertex buffer takes on the GPU
+    size_t vertexBytes() const
+    {
+        return vertexCount * (format == VertexFormat::Packed ? sizeof(PackedVertex) : sizeof(Vertex));
+    }
 
-    // initializes all the buffer objects/arrays
-    void setupMesh()
+    // creates the vertex array and points its attributes at the buffers. vertex arrays aren't shared between
+    // contexts, so this has to run on the thread that draws even when the buffers were filled on another
+    void setupVertexArray()
     {
-        // create buffers/arrays
         glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
-
         glBindVertexArray(VAO);
-        // load data into vertex buffers
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        // A great thing about structs is that their memory layout is sequential for all its items.
-        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-        // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+
+        if (format == VertexFormat::Packed)
+        {
+            setupPackedAttributes();
+            glBindVertexArray(0);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            return;
+        }
 
         // set the vertex attribute pointers
         // vertex Positions
@@ -145,6 +244,111 @@ private:
         glEnableVertexAttribArray(6);
         glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, m_Weights));
         glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // point the instance matrix attributes of this mesh's vertex array at the model's instance buffer
+    void setupInstancing(unsigned int instanceBuffer)
+    {
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        for (unsigned int column = 0; column < 4; column++)
+        {
+            glEnableVertexAttribArray(INSTANCE_MATRIX_LOCATION + column);
+            glVertexAttribPointer(INSTANCE_MATRIX_LOCATION + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(sizeof(glm::vec4) * column));
+            // advance once per instance instead of once per vertex
+            glVertexAttribDivisor(INSTANCE_MATRIX_LOCATION + column, 1);
+        }
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+private:
+    // render data 
+    unsigned int VBO, EBO;
+
+    // first texture of each type, later ones would never be sampled. types without one get the default texture,
+    // Draw skips the ones the program doesn't sample
+    void setupBindings()
+    {
+        bool bound[static_cast<size_t>(TextureType::Count)] = {};
+        for (const auto& texture : textures)
+        {
+            auto& typeBound = bound[static_cast<size_t>(texture.type)];
+            if (typeBound)
+                continue;
+
+            bindings.push_back(TextureBinding{ texture_unit(texture.type), texture.id });
+            typeBound = true;
+        }
+
+        for (size_t type = 0; type < static_cast<size_t>(TextureType::Count); type++)
+        {
+            if (!bound[type])
+                bindings.push_back(TextureBinding{ texture_unit(static_cast<TextureType>(type)), default_texture(static_cast<TextureType>(type)) });
+        }
+    }
+
+    // same locations as the full layout, so the shaders take either. the signed normalized fetch hands the normal to
+    // the shader as -1..1 floats. tangent, bitangent and the bone attributes stay disabled.
+    void setupPackedAttributes()
+    {
+        // vertex Positions
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)0);
+        // vertex normals
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, Normal));
+        // vertex texture coords
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, TexCoords));
+    }
+
+    vector<PackedVertex> packVertices() const
+    {
+        vector<PackedVertex> packed(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++)
+        {
+            const Vertex& vertex = vertices[i];
+            packed[i].Position = vertex.Position;
+            packed[i].Normal = pack_snorm_10_10_10_2(glm::vec4(vertex.Normal, 0.0f));
+            packed[i].TexCoords = glm::packHalf2x16(vertex.TexCoords);
+        }
+        return packed;
+    }
+
+    // initializes the buffer objects, any context that shares objects with the drawing one will do
+    void setupMesh()
+    {
+        // create buffers
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &EBO);
+
+        // load data into vertex buffers
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        if (format == VertexFormat::Packed)
+        {
+            vector<PackedVertex> packed = packVertices();
+            glBufferData(GL_ARRAY_BUFFER, packed.size() * sizeof(PackedVertex), &packed[0], GL_STATIC_DRAW);
+        }
+        else
+        {
+            // A great thing about structs is that their memory layout is sequential for all its items.
+            // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
+            // again translates to 3/2 floats which translates to a byte array.
+            glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+        }
+
+        // the element array binding is vertex array state, so fill the indices through a plain binding point.
+        // setupVertexArray attaches the buffer to the vertex array on the context that draws.
+        glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+        glBufferData(GL_COPY_WRITE_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        // the buffer has its own copy now, nothing reads the vertices on the CPU after this
+        vertices.clear();
+        vertices.shrink_to_fit();
     }
 };
 #endif
\ No newline at end of file
@@ -25,24 +25,28 @@ public:
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
+    // world matrices of every copy drawn this frame, refilled by the renderer
+    unsigned int instanceBuffer = 0;
+    // set by setupVertexArrays, until then there's nothing to draw
+    bool ready = false;
+    // what loadModel stores the meshes as, meshes with bones always keep the full layout
+    VertexFormat vertexFormat = VertexFormat::Full;
 
     // constructor, expects a filepath to a 3D model.
-    Model(string const& path, bool gamma = false) : gammaCorrection(gamma)
+    Model(string const& path, bool gamma = false, VertexFormat format = VertexFormat::Full) : gammaCorrection(gamma)
     {
-        loadModel(path);
+        loadModel(path, format);
+        setupVertexArrays();
     }
 
-    // draws the model, and thus all its meshes
-    void Draw(unsigned int shader)
-    {
-        for (unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].Draw(shader);
-    }
+    // empty model, to be filled by loadModel on an upload thread and finished with setupVertexArrays on the drawing one
+    Model() : gammaCorrection(false) {}
 
-private:
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
-    void loadModel(string const& path)
+    // makes buffers and textures only, so any context sharing objects with the drawing one can run it.
+    void loadModel(string const& path, VertexFormat format = VertexFormat::Full)
     {
+        vertexFormat = format;
         // read file via ASSIMP
         Assimp::Importer importer;
         const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
@@ -59,6 +63,35 @@ private:
         processNode(scene->mRootNode, scene);
     }
 
+    // vertex arrays, and the instance buffer they read from, on the context that draws
+    void setupVertexArrays()
+    {
+        glGenBuffers(1, &instanceBuffer);
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            meshes[i].setupVertexArray();
+            meshes[i].setupInstancing(instanceBuffer);
+        }
+        ready = true;
+    }
+
+    // bytes all vertex buffers take on the GPU
+    size_t vertexBytes() const
+    {
+        size_t bytes = 0;
+        for (unsigned int i = 0; i < meshes.size(); i++)
+            bytes += meshes[i].vertexBytes();
+        return bytes;
+    }
+
+    // draws the model, and thus all its meshes
+    void Draw(RenderState& state, GLsizei instanceCount = 1)
+    {
+        for (unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].Draw(state, instanceCount);
+    }
+
+private:
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
     void processNode(aiNode* node, const aiScene* scene)
     {
@@ -88,7 +121,7 @@ private:
         // walk through each of the mesh's vertices
         for (unsigned int i = 0; i < mesh->mNumVertices; i++)
         {
-            Vertex vertex;
+            Vertex vertex{}; // zeroed, the attributes a mesh lacks would otherwise be garbage, and get packed as such
             glm::vec3 vector; // we declare a placeholder vector since assimp uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
             // positions
             vector.x = mesh->mVertices[i].x;
@@ -138,39 +171,35 @@ private:
         }
         // process materials
         aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-        // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
-        // as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER. 
-        // Same applies to other texture as the following list summarizes:
-        // diffuse: texture_diffuseN
-        // specular: texture_specularN
-        // normal: texture_normalN
+        // every texture is tagged with its TextureType, which decides the unit and sampler it is read through.
+        // see textureSamplerNames in mesh.h for the sampler names the shaders have to use.
 
         // 1. diffuse maps
-        vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
+        vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, TextureType::Diffuse);
         textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
         // 2. specular maps
-        vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
+        vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, TextureType::Specular);
         textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
         // 3. normal maps
-        std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
+        std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, TextureType::Normal);
         textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
         // 4. height maps
-        std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_DISPLACEMENT, "texture_height");
+        std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_DISPLACEMENT, TextureType::Height);
         textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
         // 5. roughness maps
-        std::vector<Texture> roughMaps = loadMaterialTextures(material, aiTextureType_SHININESS, "texture_roughness");
+        std::vector<Texture> roughMaps = loadMaterialTextures(material, aiTextureType_SHININESS, TextureType::Roughness);
         textures.insert(textures.end(), roughMaps.begin(), roughMaps.end());
         // 6. ao maps
-        std::vector<Texture> aoMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_ao");
+        std::vector<Texture> aoMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, TextureType::AmbientOcclusion);
         textures.insert(textures.end(), aoMaps.begin(), aoMaps.end());
 
         // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        return Mesh(std::move(vertices), indices, textures, mesh->HasBones() ? VertexFormat::Full : vertexFormat);
     }
 
     // checks all material textures of a given type and loads the textures if they're not loaded yet.
     // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName)
+    vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, TextureType typeName)
     {
         vector<Texture> textures;
         for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)